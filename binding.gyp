@@ -9,7 +9,22 @@
 			[
 				"src/tourbox_addon.cc",
 				"src/tourbox_server.cc",
-				"src/tourbox_client.cc"
+				"src/tourbox_client.cc",
+				"src/tourbox_thread.cc",
+				"src/tourbox_events.cc",
+				"src/tourbox_dispatcher.cc",
+				"src/tourbox_velocity.cc",
+				"src/tourbox_encoders.cc",
+				"src/tourbox_sampler.cc",
+				"src/tourbox_timer.cc",
+				"src/tourbox_gestures.cc",
+				"src/tourbox_repeat.cc",
+				"src/tourbox_layers.cc",
+				"src/tourbox_sequences.cc",
+				"src/tourbox_profile.cc",
+				"src/tourbox_rcu.cc",
+				"src/tourbox_waiters.cc",
+				"src/tourbox_streams.cc"
 			],
 			"include_dirs": [
 				"node_modules/node-addon-api",
@@ -1,4 +1,5 @@
 const EventEmitter = require('events');
+const fs = require('fs');
 const path = require('path');
 
 let tourboxAddon;
@@ -12,48 +13,96 @@ try {
   }
 }
 
+// Device profiles may be given as a JSON file name or as the parsed object
+function loadProfile(profile) {
+  return typeof profile === 'string' ? JSON.parse(fs.readFileSync(path.resolve(profile), 'utf8')) : profile;
+}
+
+// Listener names that are not control events, so never part of the native subscription
+const NON_CONTROL_EVENTS = new Set(['newListener', 'removeListener', 'error', 'ready', 'connect', 'disconnect', 'sample']);
+
 class TourBox extends EventEmitter {
   constructor() {
     super();
     this.isRunning = false;
+    this.starting = false;
     this.server = null;
+    this.listening = null;
     this.rawCallback = null;
+    this.handlers = new Map();
+
+    // Keep the native filter in step with the listeners; newListener fires before the
+    // listener is added, so the update runs once the current call stack is done
+    this.subscriptionQueued = false;
+    const queueSubscriptions = () => {
+      if (this.subscriptionQueued) return;
+      this.subscriptionQueued = true;
+      queueMicrotask(() => {
+        this.subscriptionQueued = false;
+        this.updateSubscriptions();
+      });
+    };
+    this.on('newListener', queueSubscriptions);
+    this.on('removeListener', queueSubscriptions);
+    this.encoders = new Float64Array(0);
+    this.encoderIndex = {};
   }
 
   /**
    * Start the TourBox server
-   * @param {number} port - Port to listen on (default: 50500)
-   * @param {string} ip - IP address to bind to (default: "127.0.0.1", use "0.0.0.0" for all interfaces)
+   * @param {number} port - Port to listen on (default: 50500); 0 binds a free ephemeral port, see address()
+   * @param {string|string[]} ip - Address(es) or host name(s) to bind to (default: "127.0.0.1").
+   *   Use "0.0.0.0" for all IPv4 interfaces, "::" for all IPv6 (and dual-stack IPv4) interfaces,
+   *   or "*" for the wildcard address of every available family.
+   * @param {object} options - Optional server options
+   * @param {string|object} options.profile - Device profile mapping protocol bytes to controls: a path to a
+   *   JSON file or { name, controls: [{ type: 'button', name, press, release } | { type: 'rotary', name, cw, ccw }] }
+   *   (default: the built-in TourBox layout, see profiles/tourbox.json)
+   * @param {boolean} options.dualStack - Let IPv6 listeners accept IPv4 peers when no IPv4 address is bound (default: true)
+   * @param {boolean|object} options.lowLatency - Low-latency socket options for client connections.
+   *   `true` enables the whole profile; an object overrides individual fields:
+   *   { noDelay, quickAck, rcvLowat, busyPoll (microseconds), rcvBuf (bytes) }
+   * @param {boolean|string} options.timestamps - Attach the packet receive time to control events
+   *   (`true`/"ns" for SO_TIMESTAMPNS, "timestamping" for SO_TIMESTAMPING)
+   * @param {number} options.decoderIdle - Keep a run of identical rotation bytes open across packets and
+   *   only report it after this many milliseconds without new data (0 = report at the end of each packet)
+   * @param {number} options.decoderMaxHold - With decoderIdle, report a held run after at most this many
+   *   milliseconds even while data keeps arriving (default 16, 0 = no cap)
+   * @param {number|string} options.aggregate - Net knob/dial/scroll steps per axis over a window in
+   *   milliseconds (e.g. 2-16), or "tick" to aggregate until the previous rotation events were handled
+   * @param {object} options.threads - CPU / scheduling placement of the native threads:
+   *   { name, cpus, policy ('fifo' | 'rr' | 'other'), priority, nice, accept: {...}, io: {...}, dispatch: {...} }
+   * @param {boolean|object} options.gestures - Native "<Button> Tap", "<Button> DoubleTap" and "<Button> LongPress"
+   *   events: `true` or { tap, doubleTap, longPress (ms, false = off), buttons: { C1: {...} | false } }
+   * @param {boolean|object} options.repeat - Native "<Button> Repeat" events while a button is held:
+   *   `true` (D-pad) or { delay, interval | rate, buttons: ['Up', ...] | { Up: {...} | false } }
+   * @param {object[]} options.layers - Mapping layers switched by a button:
+   *   [{ name, button, mode ('hold' | 'toggle'), map: { 'Knob CW': 'Volume Up', ... } }]
+   * @param {object[]} options.sequences - Multi-step shortcuts, each emitted as an event named `name`:
+   *   [{ name, steps: ['Up', 'Up', { control: 'Down', within: 300 }, ...], window, timeout }]
+   * @param {number} options.sample - Sampling mode: publish one consolidated 'sample' event at this rate
+   *   (Hz, e.g. 60/120/240) instead of individual control events
+   * @param {object[]} options.encoders - Virtual absolute encoders, read through `tourbox.encoders`:
+   *   [{ name, control (a rotary: 'Knob' | 'Scroll' | 'Dial' | ...), min, max, step, value, wrap, notify }]
+   * @param {boolean|string|object} options.acceleration - Scale rotation deltas by how fast the control turns:
+   *   `true`, "power", "linear" or { curve, gain, slope, threshold, exponent, table, max, smoothing, reset,
+   *   knob: {...}, scroll: {...}, dial: {...} }
+   * @param {boolean} options.embedded - Decode on the Node.js event loop (uv_poll) instead of native threads:
+   *   lowest overhead for a single console; not combinable with sample, gestures, repeat, aggregate or decoderIdle
    * @returns {boolean} Success status
    */
-  startServer(port = 50500, ip = "127.0.0.1") {
-    if (this.isRunning) {
+  startServer(port = 50500, ip = "127.0.0.1", options = {}) {
+    if (this.isRunning || this.starting) {
       console.warn('TourBox server is already running');
       return false;
     }
 
     try {
-      // Create server with event callback and optional raw callback
-      this.server = tourboxAddon.createServer(port, 
-        (eventName, data) => {
-          // Handle connection events (data is connection info object)
-          if (eventName === 'connect' || eventName === 'disconnect') {
-            this.emit(eventName, data);
-            this.emit('*', eventName, data);
-          } else {
-            // Handle control events (data is count)
-            this.emit(eventName, data);
-            this.emit('*', eventName, data);
-          }
-        },
-        ip,
-        this.rawCallback ? (buffer) => {
-          this.rawCallback(buffer);
-        } : undefined
-      );
-
-      if (this.server) {
-        this.isRunning = true;
+      options = this.resolveOptions(options);
+      const info = tourboxAddon.createServer(...this.serverArguments(port, ip, options));
+
+      if (info) {
+        this.serverStarted(info, options);
         //console.log(`TourBox server started on ${ip}:${port}`);
         return true;
       }
@@ -64,6 +113,99 @@ class TourBox extends EventEmitter {
     return false;
   }
 
+  /**
+   * Start the TourBox server without blocking the event loop: address resolution, bind() and the
+   * native thread start-up run on a worker thread
+   * @param {number} port - Port to listen on (default: 50500, 0 = ephemeral)
+   * @param {string|string[]} ip - Address(es) or host name(s) to bind to (default: "127.0.0.1")
+   * @param {object} options - Server options, as for startServer()
+   * @returns {Promise<number>} The bound port, once the server accepts connections; rejects if the
+   *   server is already running or cannot be started
+   */
+  async startServerAsync(port = 50500, ip = "127.0.0.1", options = {}) {
+    if (this.isRunning || this.starting) throw new Error('TourBox server is already running');
+
+    options = this.resolveOptions(options);
+    this.starting = true;
+    try {
+      const info = await tourboxAddon.startServerAsync(...this.serverArguments(port, ip, options));
+      this.serverStarted(info, options);
+      return info.port;
+    } finally {
+      this.starting = false;
+    }
+  }
+
+  /**
+   * Load a profile given as a file name; the addon compiles the parsed object
+   */
+  resolveOptions(options) {
+    if (typeof options.profile === 'string') {
+      return Object.assign({}, options, { profile: loadProfile(options.profile) });
+    }
+    return options;
+  }
+
+  /**
+   * Arguments for the addon's createServer / startServerAsync: event callback and optional raw callback
+   */
+  serverArguments(port, ip, options) {
+    return [port,
+      (eventName, data, timestamp, delta) => {
+        // Handle connection and sample events (data is an info / state object)
+        if (eventName === 'connect' || eventName === 'disconnect' || eventName === 'sample') {
+          this.emit(eventName, data);
+          this.emit('*', eventName, data);
+        } else if (delta !== undefined) {
+          // Rotation with signed delta (options.aggregate / options.acceleration)
+          this.emit(eventName, data, timestamp, delta);
+          this.emit('*', eventName, data, timestamp, delta);
+        } else if (timestamp !== undefined) {
+          // Control event with receive timestamp (options.timestamps)
+          this.emit(eventName, data, timestamp);
+          this.emit('*', eventName, data, timestamp);
+        } else {
+          // Handle control events (data is count)
+          this.emit(eventName, data);
+          this.emit('*', eventName, data);
+        }
+      },
+      ip,
+      this.rawCallback ? (buffer) => {
+        this.rawCallback(buffer);
+      } : undefined,
+      options
+    ];
+  }
+
+  /**
+   * Bookkeeping once the addon reports a running server; 'ready' follows on the next tick so
+   * listeners added right after startServer() still see it
+   */
+  serverStarted(info, options) {
+    this.server = info.serverId;
+    this.listening = { port: info.port, addresses: info.addresses };
+    this.isRunning = true;
+    this.bindHandlers();
+    this.updateSubscriptions();
+    this.encoderIndex = {};
+    (options.encoders || []).forEach((encoder, index) => { this.encoderIndex[encoder.name] = index; });
+    this.encoders = tourboxAddon.encoders(this.server) || new Float64Array(0);
+    const listening = this.listening;
+    process.nextTick(() => {
+      if (this.listening === listening) this.emit('ready', listening);
+    });
+  }
+
+  /**
+   * Where the server listens, as bound by the kernel (the real port when started on port 0)
+   * @returns {{port: number, addresses: {address: string, family: string, port: number}[]}|null}
+   *   null while the server is not running
+   */
+  address() {
+    return this.listening;
+  }
+
   /**
    * Stop the TourBox server
    * @returns {boolean} Success status
@@ -77,6 +219,7 @@ class TourBox extends EventEmitter {
     try {
       tourboxAddon.stopServer(this.server);
       this.server = null;
+      this.listening = null;
       this.isRunning = false;
       //console.log('TourBox server stopped');
       return true;
@@ -86,6 +229,21 @@ class TourBox extends EventEmitter {
     }
   }
 
+  /**
+   * Stop the TourBox server without blocking the event loop; the native threads are joined on a
+   * worker thread. Pending waitFor() promises reject and event streams end right away.
+   * @returns {Promise<boolean>} Resolves once the server is fully torn down (false if it was not running)
+   */
+  async stopServerAsync() {
+    if (!this.isRunning || !this.server) return false;
+
+    const server = this.server;
+    this.server = null;
+    this.listening = null;
+    this.isRunning = false;
+    return tourboxAddon.stopServerAsync(server);
+  }
+
   /**
    * Check if server is running
    * @returns {boolean} Running status
@@ -107,22 +265,149 @@ class TourBox extends EventEmitter {
     return this;
   }
 
+  /**
+   * Get a virtual encoder's current value
+   * @param {string} name - Encoder name from options.encoders
+   * @returns {number|undefined} Value, or undefined for an unknown encoder
+   */
+  encoder(name) {
+    const index = this.encoderIndex[name];
+    return index === undefined ? undefined : this.encoders[index];
+  }
+
+  /**
+   * Set a virtual encoder (limited to its range)
+   * @param {string} name - Encoder name from options.encoders
+   * @param {number} value - New value
+   * @returns {boolean} Success status
+   */
+  setEncoder(name, value) {
+    const index = this.encoderIndex[name];
+    if (index === undefined || !this.server) return false;
+    return !!tourboxAddon.setEncoder(this.server, index, value);
+  }
+
+  /**
+   * Switch the device profile while the server runs. Connections, held buttons and encoders are kept;
+   * each connection decodes with the new profile from its next packet on. Options that name controls
+   * (gestures, repeat, layers, sequences) keep the byte codes they were resolved to at start.
+   * @param {string|object} profile - Path to a profile JSON file or the profile object (see options.profile)
+   * @returns {boolean} true if the profile was applied
+   */
+  setProfile(profile) {
+    if (!this.server) return false;
+    try {
+      if (!tourboxAddon.setProfile(this.server, loadProfile(profile))) return false;
+      // The new profile may define events that handlers and listeners were waiting for
+      this.bindHandlers();
+      this.updateSubscriptions();
+      return true;
+    } catch (error) {
+      console.error('Failed to set TourBox profile:', error.message);
+      return false;
+    }
+  }
+
+  /**
+   * Tell the addon which control events have listeners; the others are dropped natively
+   * before they are queued for JavaScript, unless a handler takes them. A '*' listener
+   * subscribes to everything.
+   */
+  updateSubscriptions() {
+    if (!this.server) return;
+    const names = this.eventNames().filter((name) => typeof name === 'string' && !NON_CONTROL_EVENTS.has(name));
+    tourboxAddon.subscribe(this.server, names.includes('*') ? true : names);
+  }
+
+  /**
+   * Wait for the next event of a control, matched natively as the event decodes
+   * @param {string} control - Event name ("C1 Release", "Tall DoubleTap") or a button ("Tour" = "Tour Press")
+   * @param {number} timeout - Milliseconds before the promise rejects with code 'ETIMEDOUT' (default: no timeout)
+   * @returns {Promise<{name: string, count: number, timestamp: number|undefined, delta: number|undefined}>}
+   *   Rejects as well when the server is not running or is stopped while waiting, or for a name no event has
+   */
+  waitFor(control, timeout = 0) {
+    if (!this.server) return Promise.reject(new Error('TourBox server is not running'));
+    return tourboxAddon.waitFor(this.server, control, timeout);
+  }
+
+  /**
+   * Iterate over control events with `for await`. The stream has its own native queue and events
+   * are handed to JavaScript only when the loop asks for more, so a slow consumer never floods
+   * the event loop: queued rotation steps merge into one entry per control, and only once 4096
+   * unread press / release events have piled up are further events dropped.
+   * @param {Object} options - Stream options
+   * @param {string[]} options.controls - Event names / buttons to receive (default: every control event)
+   * @param {number} options.batch - Yield arrays of up to this many events instead of single events
+   * @returns {AsyncGenerator<Object|Object[]>} Events as { name, count, timestamp, delta }; ends when
+   *   the server stops. Batch arrays carry a `dropped` count when events were lost; single events
+   *   throw an error with code 'EOVERFLOW' and that count instead. Throws for a name no event has.
+   */
+  events({ controls = [], batch = 0 } = {}) {
+    if (!this.server) throw new Error('TourBox server is not running');
+    const server = this.server;
+    // Opened now, not on the first next(), so nothing between here and the loop is missed
+    const stream = tourboxAddon.openStream(server, controls, batch);
+    if (stream == null) throw new Error('TourBox server is not running');
+
+    return (async function* () {
+      try {
+        for (;;) {
+          const events = await tourboxAddon.streamNext(server, stream);
+          if (events === null) return;
+          if (batch) {
+            yield events;
+            continue;
+          }
+          // Single events have nowhere to carry the count, and a silent gap could leave a button held
+          if (events.dropped) {
+            const error = new Error('TourBox stream queue full, ' + events.dropped + ' event(s) dropped');
+            error.code = 'EOVERFLOW';
+            error.dropped = events.dropped;
+            throw error;
+          }
+          yield* events;
+        }
+      } finally {
+        tourboxAddon.closeStream(server, stream);
+      }
+    })();
+  }
+
+  /**
+   * Register a handler the addon calls directly for one control, bypassing EventEmitter dispatch.
+   * Events that reach a handler (the control's own or the '*' catch-all) are emitted as well only
+   * when the EventEmitter has listeners for them (or a '*' listener).
+   * @param {string} control - Control / event name (e.g. "Knob CW"), or "*" for every event
+   * @param {function|null} handler - fn(count, timestamp, delta) for a control, fn(name, count, timestamp, delta)
+   *   for "*"; null removes the handler
+   * @returns {boolean} true if the handler is active now; false when the server is not running or no event
+   *   has that name yet (it is kept and bound once the server starts or a profile defining the event is set)
+   */
+  registerHandler(control, handler) {
+    if (typeof control !== 'string' || (handler != null && typeof handler !== 'function')) {
+      throw new TypeError('registerHandler expects (control: string, handler: function | null)');
+    }
+    if (handler) this.handlers.set(control, handler);
+    else this.handlers.delete(control);
+    const bound = this.server ? tourboxAddon.registerHandler(this.server, control, handler || null) : false;
+    return !!bound || !handler;
+  }
+
+  /**
+   * Hand every registered handler to the server's native table; names only get an event id once a
+   * profile or option defines them, so handlers registered early are bound here
+   */
+  bindHandlers() {
+    for (const [control, handler] of this.handlers) tourboxAddon.registerHandler(this.server, control, handler);
+  }
+
   /**
    * Get available control names
-   * @returns {string[]} Array of control names
+   * @returns {string[]} Event names of the active device profile (the built-in one while stopped)
    */
   getAvailableControls() {
-    return [
-      'Knob CCW', 'Knob CW', 'Knob Press', 'Knob Release',
-      'Scroll Down', 'Scroll Up', 'Scroll Press', 'Scroll Release',
-      'Dial CCW', 'Dial CW', 'Dial Press', 'Dial Release',
-      'Up Press', 'Up Release', 'Down Press', 'Down Release',
-      'Left Press', 'Left Release', 'Right Press', 'Right Release',
-      'Tall Press', 'Tall/Side Release', 'Side Press',
-      'Short Press', 'Short Release', 'Top Press', 'Top Release',
-      'Tour Press', 'Tour Release', 'C1 Press', 'C1 Release',
-      'C2 Press', 'C2 Release'
-    ];
+    return tourboxAddon.controls(this.server || undefined);
   }
 
   /**
@@ -1,26 +1,128 @@
 #include <napi.h>
+#include <uv.h>
 #include "tourbox_server.h"
+#include "tourbox_client.h"
 #include <memory>
 #include <map>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <mutex>
 
 static std::map<int, std::shared_ptr<TourBoxServerWrapper>> g_servers;
 static int g_nextServerId = 1;
-static Napi::ThreadSafeFunction g_eventCallback;
-static Napi::ThreadSafeFunction g_rawCallback;
-
-// Map control names to their byte codes (must match client's controlMap names)
-static std::map<std::string, int> g_nameToCode = {
-    {"Knob CCW", 132}, {"Knob CW", 196}, {"Scroll Down", 137}, {"Scroll Up", 201},
-    {"Dial CCW", 143}, {"Dial CW", 207}, {"Knob Press", 55}, {"Knob Release", 183},
-    {"Dial Press", 56}, {"Dial Release", 184}, {"Up Press", 16}, {"Up Release", 144},
-    {"Down Press", 17}, {"Down Release", 145}, {"Left Press", 18}, {"Left Release", 146},
-    {"Right Press", 19}, {"Right Release", 147}, {"Tall Press", 0}, {"Tall Release", 128},
-    {"Side Press", 1}, {"Side Release", 129}, {"Top Press", 2}, {"Top Release", 130},
-    {"Short Press", 3}, {"Short Release", 131}, {"Tour Press", 42}, {"Tour Release", 170},
-    {"C1 Press", 34}, {"C1 Release", 162}, {"C2 Press", 35}, {"C2 Release", 163},
-    {"Scroll Press", 10}, {"Scroll Release", 138}
+
+// Thread-safe callbacks of each server by id, called from its native threads. Added before the
+// server starts and removed once it has stopped; the lock keeps a call from racing the release.
+struct ServerCallbacks
+{
+    Napi::ThreadSafeFunction event;
+    Napi::ThreadSafeFunction raw;		// only with a raw data callback
+};
+static std::map<int, ServerCallbacks> g_callbacks;
+static std::mutex g_callbacksMutex;
+
+// Queue data for the event (or raw) callback of server owner; false if it has none or the queue refused it
+template <typename DataType, typename Callback>
+static bool CallServer(int owner, bool raw, DataType* data, Callback callback)
+{
+    std::lock_guard<std::mutex> g(g_callbacksMutex);
+    auto it = g_callbacks.find(owner);
+    if (it == g_callbacks.end()) return false;
+    Napi::ThreadSafeFunction& fn = raw ? it->second.raw : it->second.event;
+    return fn && fn.NonBlockingCall(data, callback) == napi_ok;
+}
+
+// Native handlers of one server by event id plus a catch-all, called straight from the event
+// callback (JavaScript thread only), and the events its EventEmitter has listeners for.
+// An event that reaches a handler is emitted as well only when a listener wants it.
+struct ServerHandlers
+{
+    Napi::FunctionReference byId[kMaxEventIds];
+    Napi::FunctionReference catchAll;
+    std::vector<bool> listened = std::vector<bool>(kMaxEventIds, false);
+    bool listenedAll = true;		// a '*' listener, or subscribe() not called yet
+};
+static std::map<int, std::shared_ptr<ServerHandlers>> g_handlers;
+
+// Promises returned by waitFor(), settled on the JavaScript thread
+struct PendingWaiter
+{
+    int serverId;
+    std::string control;
+    Napi::Promise::Deferred deferred;
+};
+static std::map<uint64_t, PendingWaiter> g_waiters;
+static uint64_t g_nextWaiterId = 1;
+
+// Pending streamNext() promises by stream id; at most one per stream
+struct PendingPull
+{
+    int serverId;
+    Napi::Promise::Deferred deferred;
+};
+static std::map<uint64_t, PendingPull> g_streamPulls;
+
+// Embedded mode (no server threads): listening and client sockets are polled on the Node.js event loop,
+// and events are decoded and handed to these callbacks inline, without thread-safe functions
+static napi_env g_inlineEnv = nullptr;
+static std::unique_ptr<Napi::AsyncContext> g_inlineContext;
+
+// Callbacks of the embedded server being created, taken over by StartEmbedded
+static Napi::FunctionReference g_inlineEventCallback;
+static Napi::FunctionReference g_inlineRawCallback;
+
+struct EmbeddedServer;
+
+// One polled socket: a listener, or a client together with its decoder
+struct EmbeddedHandle
+{
+    uv_poll_t poll;
+    EmbeddedServer* owner;
+    socket_t socket;
+    std::unique_ptr<TourBoxClientWrapper> client;    // null for a listener
+    std::string ip;
+    int port;
 };
 
+struct EmbeddedServer
+{
+    std::shared_ptr<TourBoxServerWrapper> server;
+    std::vector<EmbeddedHandle*> handles;
+    Napi::FunctionReference eventCallback;     // reset on stop, so nothing is called after stopServer()
+    Napi::FunctionReference rawCallback;
+    int busy;           // poll callbacks on the stack; a stop from inside one waits for it to return
+    bool stopping;
+};
+static std::map<int, EmbeddedServer*> g_embedded;
+
+// Byte code of a control in a profile: the exact event name, else "<name> Press"; -1 if unknown
+static int ResolveControlCode(const DeviceProfile& profile, const std::string& name)
+{
+    int code = profile.CodeOf(name);
+    if (code < 0) code = profile.CodeOf(name + " Press");
+    return code;
+}
+
+// Id of an event name an option defines; throws a RangeError (false) once every event id is taken,
+// instead of letting the name share an id with another event
+static bool InternOptionName(Napi::Env env, const std::string& what, const std::string& name, uint16_t& id)
+{
+    id = InternEventName(name);
+    if (id != kInvalidEventId) return true;
+    Napi::RangeError::New(env, what + ": no event id left for '" + name + "', at most " + std::to_string(kMaxEventIds) + " event names can exist")
+        .ThrowAsJavaScriptException();
+    return false;
+}
+
+// Option / sample key of a rotary control ("Knob" -> "knob")
+static std::string RotaryKey(const std::string& rotary)
+{
+    std::string key = rotary;
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return key;
+}
+
 // buttonState(serverId, controlName)
 Napi::Value ButtonState(const Napi::CallbackInfo& info)
 {
@@ -48,26 +150,16 @@ Napi::Value ButtonState(const Napi::CallbackInfo& info)
         return env.Null();
     }
 
-    // map name to code (try exact, then try "<name> Press")
-    auto nit = g_nameToCode.find(name);
-    if (nit == g_nameToCode.end()) {
-        std::string alt = name + " Press";
-        nit = g_nameToCode.find(alt);
-        if (nit == g_nameToCode.end()) {
-            return Napi::Boolean::New(env, false);
-        }
-    }
-
-    int code = nit->second;
-
+    // map name to code through each server's profile (try exact, then try "<name> Press")
     if (checkAll) {
         // return true if any server reports this code held
         for (auto& kv : g_servers) {
             auto server = kv.second.get();
             if (!server) continue;
-                if (server->IsButtonHeld(code)) {
-                    return Napi::Boolean::New(env, true);
-                }
+            int code = ResolveControlCode(*server->profiles.Current(), name);
+            if (code >= 0 && server->IsButtonHeld(code)) {
+                return Napi::Boolean::New(env, true);
+            }
         }
         return Napi::Boolean::New(env, false);
     } else {
@@ -75,192 +167,2014 @@ Napi::Value ButtonState(const Napi::CallbackInfo& info)
         if (sit == g_servers.end()) return Napi::Boolean::New(env, false);
         auto server = sit->second.get();
         if (!server) return Napi::Boolean::New(env, false);
-            bool held = server->IsButtonHeld(code);
+        int code = ResolveControlCode(*server->profiles.Current(), name);
+        if (code < 0) return Napi::Boolean::New(env, false);
+        bool held = server->IsButtonHeld(code);
         return Napi::Boolean::New(env, held);
     }
 }
 
-// Function to emit events to Node.js
-void EmitToNode(const std::string& eventName, int count) 
+// Call the listeners for decoded events: (name, count[, timestamp[, delta]]), per-control handlers without the name.
+// timestampNs is the packet receive time (ns since the Unix epoch), passed on as milliseconds when set
+// stopped (inline delivery) ends the batch as soon as a callback stops the server
+static void CallEventListeners(Napi::Env env, Napi::Function jsCallback, int owner, const std::vector<TourBoxEvent>& events,
+                               const bool* stopped = nullptr)
 {
-    if (g_eventCallback) 
-	{
-        auto callback = [eventName, count](Napi::Env env, Napi::Function jsCallback) 
-		{
-            jsCallback.Call(
-			{
-                Napi::String::New(env, eventName),
-                Napi::Number::New(env, count)
-            });
-        };
-        g_eventCallback.NonBlockingCall(callback);
+    std::vector<napi_value> args;
+    std::vector<napi_value> handlerArgs;
+    for (const TourBoxEvent& ev : events)
+    {
+        if (ev.kind == EventKind::Raw) continue;
+        if (stopped && *stopped) break;
+
+        // Looked up per event and held: a handler may stop the server, which drops its table
+        auto found = g_handlers.find(owner);
+        std::shared_ptr<ServerHandlers> handlers = found != g_handlers.end() ? found->second : nullptr;
+
+        args.clear();
+        args.push_back(Napi::String::New(env, EventName(ev.id)));
+        args.push_back(Napi::Number::New(env, ev.count));
+        if (ev.timestampNs || ev.hasValue)
+        {
+            args.push_back(ev.timestampNs ? (napi_value)Napi::Number::New(env, ev.timestampNs / 1e6) : (napi_value)env.Undefined());
+        }
+        if (ev.hasValue)
+        {
+            args.push_back(Napi::Number::New(env, ev.value));
+        }
+
+        if (!handlers || ev.id >= kMaxEventIds)
+        {
+            jsCallback.Call(args);
+            continue;
+        }
+
+        bool handled = false;
+        if (!handlers->byId[ev.id].IsEmpty())
+        {
+            handlerArgs.assign(args.begin() + 1, args.end());
+            handlers->byId[ev.id].Call(handlerArgs);
+            handled = true;
+        }
+        if (!handlers->catchAll.IsEmpty())
+        {
+            handlers->catchAll.Call(args);
+            handled = true;
+        }
+        if (!handled || handlers->listenedAll || handlers->listened[ev.id])
+        {
+            jsCallback.Call(args);
+        }
     }
 }
 
-// Function to emit raw data to Node.js
-void EmitRawData(const char* buffer, int length) 
+// Deliver a batch of decoded events from the dispatcher thread to Node.js
+// One thread-safe call per batch; control events go to the event callback, raw packets to the raw callback
+void DeliverEvents(EventBatch* batch) 
 {
-    if (g_rawCallback) 
-	{
-        // Copy the buffer data for thread safety
-        std::vector<uint8_t> data(buffer, buffer + length);
-        auto callback = [data](Napi::Env env, Napi::Function jsCallback) 
-		{
-            Napi::Buffer<uint8_t> nodeBuffer = Napi::Buffer<uint8_t>::Copy(env, data.data(), data.size());
-            jsCallback.Call({nodeBuffer});
+    std::vector<std::vector<uint8_t>*> rawPackets;
+    for (const TourBoxEvent& ev : batch->events)
+    {
+        if (ev.kind == EventKind::Raw) rawPackets.push_back(ev.raw);
+    }
+    size_t rawCount = rawPackets.size();
+
+    if (rawCount)
+    {
+        auto* packets = new std::vector<std::vector<uint8_t>*>(std::move(rawPackets));
+        auto callback = [](Napi::Env env, Napi::Function jsCallback, std::vector<std::vector<uint8_t>*>* packets) 
+        {
+            for (std::vector<uint8_t>* data : *packets)
+            {
+                if (env != nullptr)
+                {
+                    Napi::Buffer<uint8_t> nodeBuffer = Napi::Buffer<uint8_t>::Copy(env, data->data(), data->size());
+                    jsCallback.Call({nodeBuffer});
+                }
+                delete data;
+            }
+            delete packets;
         };
-        g_rawCallback.NonBlockingCall(callback);
+        if (!CallServer(batch->owner, true, packets, callback))
+        {
+            for (std::vector<uint8_t>* data : *packets) delete data;
+            delete packets;
+        }
+    }
+
+    if (rawCount == batch->events.size()) 
+	{
+        batch->Delivered();
+        delete batch;
+        return;
+    }
+
+    auto callback = [](Napi::Env env, Napi::Function jsCallback, EventBatch* batch) 
+    {
+        if (env != nullptr)
+        {
+            CallEventListeners(env, jsCallback, batch->owner, batch->events);
+        }
+        batch->Delivered();
+        delete batch;
+    };
+    if (!CallServer(batch->owner, false, batch, callback))
+    {
+        batch->Delivered();
+        delete batch;
     }
 }
 
 // Function to emit connection events to Node.js
-void EmitConnectionEvent(const std::string& eventType, const std::string& ip, int port) 
+void EmitConnectionEvent(int owner, const std::string& eventType, const std::string& ip, int port) 
 {
-    if (g_eventCallback) 
+    auto* info = new std::pair<std::string, int>(ip, port);
+    auto callback = [eventType](Napi::Env env, Napi::Function jsCallback, std::pair<std::string, int>* info) 
 	{
-        auto callback = [eventType, ip, port](Napi::Env env, Napi::Function jsCallback) 
-		{
+        if (env != nullptr)
+        {
             Napi::Object connectionInfo = Napi::Object::New(env);
-            connectionInfo.Set("ip", Napi::String::New(env, ip));
-            connectionInfo.Set("port", Napi::Number::New(env, port));
+            connectionInfo.Set("ip", Napi::String::New(env, info->first));
+            connectionInfo.Set("port", Napi::Number::New(env, info->second));
             
             jsCallback.Call({
                 Napi::String::New(env, eventType),
                 connectionInfo
             });
-        };
-        g_eventCallback.NonBlockingCall(callback);
+        }
+        delete info;
+    };
+    if (!CallServer(owner, false, info, callback)) delete info;
+}
+
+// A JavaScript callback invoked inline threw: report it like any uncaught exception
+static void ReportInlineException(Napi::Env env)
+{
+    if (env.IsExceptionPending())
+    {
+        napi_fatal_exception(env, env.GetAndClearPendingException().Value());
     }
 }
 
-// Create TourBox server
-Napi::Value CreateServer(const Napi::CallbackInfo& info) 
+// Embedded mode: call the callbacks for events decoded on this (the JavaScript) thread, see TourBoxDispatcher::Notify
+// A stopped server is no longer in g_embedded: what its teardown still flushes is dropped here
+void DeliverEventsInline(int owner, std::vector<TourBoxEvent>& events)
 {
-    Napi::Env env = info.Env();
+    auto it = g_embedded.find(owner);
+    EmbeddedServer* server = it != g_embedded.end() ? it->second : nullptr;
 
-    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsFunction()) 
-	{
-        Napi::TypeError::New(env, "Expected arguments: (port: number, eventCallback: function, ip?: string, rawCallback?: function)")
-            .ThrowAsJavaScriptException();
-        return env.Null();
+    Napi::Env env(g_inlineEnv);
+    Napi::HandleScope scope(env);
+
+    for (const TourBoxEvent& ev : events)
+    {
+        if (ev.kind != EventKind::Raw) continue;
+        if (server && !server->stopping && !server->rawCallback.IsEmpty())
+        {
+            server->rawCallback.Call({ Napi::Buffer<uint8_t>::Copy(env, ev.raw->data(), ev.raw->size()) });
+        }
+        delete ev.raw;
     }
 
-    int port = info[0].As<Napi::Number>().Int32Value();
-    Napi::Function eventCallback = info[1].As<Napi::Function>();
-    std::string ip = "127.0.0.1";
-    
-    // Check if IP address is provided as third parameter
-    size_t rawCallbackIndex = 2;
-    if (info.Length() >= 3 && info[2].IsString()) 
+    if (server && !server->stopping && !server->eventCallback.IsEmpty())
     {
-        ip = info[2].As<Napi::String>().Utf8Value();
-        rawCallbackIndex = 3;
+        CallEventListeners(env, server->eventCallback.Value(), owner, events, &server->stopping);
     }
+    ReportInlineException(env);
+}
 
-    // Create thread-safe event callback
-    g_eventCallback = Napi::ThreadSafeFunction::New(
-        env,
-        eventCallback,
-        "TourBoxEventCallback",
-        0,  // Unlimited queue
-        1   // One thread
-    );
+// Embedded mode: "connect" / "disconnect" straight to the event callback, in order with the events
+static void EmitConnectionEventInline(Napi::Env env, EmbeddedServer* owner, const char* eventType, const std::string& ip, int port)
+{
+    if (owner->stopping || owner->eventCallback.IsEmpty()) return;
 
-    // Create thread-safe raw callback if provided
-    if (info.Length() > rawCallbackIndex && info[rawCallbackIndex].IsFunction()) 
-	{
-        Napi::Function rawCallback = info[rawCallbackIndex].As<Napi::Function>();
-        g_rawCallback = Napi::ThreadSafeFunction::New(
-            env,
-            rawCallback,
-            "TourBoxRawCallback",
-            0,  // Unlimited queue
-            1   // One thread
-        );
+    Napi::Object connectionInfo = Napi::Object::New(env);
+    connectionInfo.Set("ip", Napi::String::New(env, ip));
+    connectionInfo.Set("port", Napi::Number::New(env, port));
+    owner->eventCallback.Call({ Napi::String::New(env, eventType), connectionInfo });
+    ReportInlineException(env);
+}
+
+// Stop polling a handle and free it once libuv is done with it
+static void CloseEmbeddedHandle(EmbeddedHandle* handle)
+{
+    uv_poll_stop(&handle->poll);
+    uv_close((uv_handle_t*)&handle->poll, [](uv_handle_t* closed)
+    {
+        delete (EmbeddedHandle*)closed->data;
+    });
+}
+
+// A client connection ended: deliver what it still had, close it and report the disconnect
+static void CloseEmbeddedClient(Napi::Env env, EmbeddedHandle* handle)
+{
+    EmbeddedServer* owner = handle->owner;
+    owner->handles.erase(std::remove(owner->handles.begin(), owner->handles.end(), handle), owner->handles.end());
+
+    // Not polled any more before the client closes the socket
+    uv_poll_stop(&handle->poll);
+    handle->client->Finish();
+    handle->client.reset();
+
+    EmitConnectionEventInline(env, owner, "disconnect", handle->ip, handle->port);
+    CloseEmbeddedHandle(handle);
+}
+
+// Close every socket of a stopped embedded server and free it
+static void TeardownEmbedded(Napi::Env env, EmbeddedServer* owner)
+{
+    std::vector<EmbeddedHandle*> handles = owner->handles;
+    for (EmbeddedHandle* handle : handles)
+    {
+        if (handle->client)
+        {
+            CloseEmbeddedClient(env, handle);
+        }
+        else
+        {
+            CloseEmbeddedHandle(handle);
+        }
     }
+    owner->handles.clear();
 
-    try 
-	{
-        auto server = std::make_shared<TourBoxServerWrapper>();
-        
-        if (!server->Initialize()) 
-		{
-            Napi::Error::New(env, "Failed to initialize TourBox server")
-                .ThrowAsJavaScriptException();
-            return env.Null();
+    // Nothing polls the listeners any more; Stop() closes them and the remaining helpers
+    owner->server->Stop();
+    delete owner;
+}
+
+// Poll callbacks run JavaScript, so they open a callback scope (microtasks and nextTick run when it closes)
+// and finish a stop requested from inside them once the decoder is off the stack
+static void OnEmbeddedReadable(uv_poll_t* poll, int status, int events)
+{
+    EmbeddedHandle* handle = (EmbeddedHandle*)poll->data;
+    EmbeddedServer* owner = handle->owner;
+    if (owner->stopping) return;
+
+    // Only UV_READABLE is polled for; an error status closes a client
+    bool readable = status >= 0 && (events & UV_READABLE);
+
+    Napi::Env env(g_inlineEnv);
+    Napi::HandleScope scope(env);
+    Napi::CallbackScope callbackScope(env, *g_inlineContext);
+    owner->busy++;
+
+    if (handle->client)
+    {
+        if (status < 0 || (readable && !handle->client->Poll())) CloseEmbeddedClient(env, handle);
+    }
+    else if (readable)
+    {
+        std::string ip;
+        int port = 0;
+        TourBoxClientWrapper* client = owner->server->AcceptClient(handle->socket, ip, port);
+        if (client)
+        {
+            uv_loop_t* loop = nullptr;
+            napi_get_uv_event_loop(env, &loop);
+
+            EmbeddedHandle* connection = new EmbeddedHandle();
+            connection->owner = owner;
+            connection->socket = client->Socket();
+            connection->client.reset(client);
+            connection->ip = ip;
+            connection->port = port;
+            connection->poll.data = connection;
+            uv_poll_init_socket(loop, &connection->poll, connection->socket);
+            owner->handles.push_back(connection);
+
+            client->Begin();
+            EmitConnectionEventInline(env, owner, "connect", ip, port);
+            uv_poll_start(&connection->poll, UV_READABLE, OnEmbeddedReadable);
         }
+    }
 
-        if (!server->StartServer(port, ip)) 
-		{
-            Napi::Error::New(env, "Failed to start TourBox server on " + ip + ":" + std::to_string(port))
-                .ThrowAsJavaScriptException();
-            return env.Null();
+    if (--owner->busy == 0 && owner->stopping) TeardownEmbedded(env, owner);
+}
+
+// Start polling the listeners of a started embedded server
+static void StartEmbedded(Napi::Env env, int serverId, const std::shared_ptr<TourBoxServerWrapper>& server)
+{
+    uv_loop_t* loop = nullptr;
+    napi_get_uv_event_loop(env, &loop);
+
+    EmbeddedServer* owner = new EmbeddedServer();
+    owner->server = server;
+    owner->eventCallback = std::move(g_inlineEventCallback);
+    owner->rawCallback = std::move(g_inlineRawCallback);
+    owner->busy = 0;
+    owner->stopping = false;
+    for (socket_t listener : server->Listeners())
+    {
+        EmbeddedHandle* handle = new EmbeddedHandle();
+        handle->owner = owner;
+        handle->socket = listener;
+        handle->port = 0;
+        handle->poll.data = handle;
+        uv_poll_init_socket(loop, &handle->poll, listener);
+        uv_poll_start(&handle->poll, UV_READABLE, OnEmbeddedReadable);
+        owner->handles.push_back(handle);
+    }
+    g_embedded[serverId] = owner;
+}
+
+// Stop an embedded server (false if the server is not one); from inside a callback it completes once that returns
+static bool StopEmbedded(Napi::Env env, int serverId)
+{
+    auto it = g_embedded.find(serverId);
+    if (it == g_embedded.end()) return false;
+
+    EmbeddedServer* owner = it->second;
+    g_embedded.erase(it);
+    owner->stopping = true;
+
+    // Nothing reaches JavaScript once stopServer() returns: the callbacks go and queued events are
+    // dropped now, even when a callback on the stack defers the teardown
+    owner->eventCallback.Reset();
+    owner->rawCallback.Reset();
+    owner->server->dispatcher.DiscardInline();
+
+    // Waiters and streams settle through the thread-safe function, which the caller releases next
+    owner->server->waiters.Clear();
+    owner->server->streams.CloseAll();
+
+    if (!owner->busy) TeardownEmbedded(env, owner);
+    return true;
+}
+
+// Button names for the bits of a sample's held / pressed masks (bit = press code)
+static Napi::Array SampleButtons(Napi::Env env, const DeviceProfile& profile, uint64_t mask)
+{
+    Napi::Array names = Napi::Array::New(env);
+    uint32_t n = 0;
+    for (const ProfileButton& button : profile.Buttons())
+    {
+        if (button.pressCode >= kMaxSampleCodes || !(mask & (1ULL << button.pressCode))) continue;
+        names.Set(n++, Napi::String::New(env, button.name));
+    }
+    return names;
+}
+
+// Deliver a fixed-rate state sample to Node.js as a 'sample' event
+// { knob, scroll, dial, steps: { knob, scroll, dial }, held, pressed, timestamp, missed }
+// (one key per rotary of the profile, lower-cased)
+void DeliverSample(int owner, SampleRecord* record)
+{
+    auto callback = [](Napi::Env env, Napi::Function jsCallback, SampleRecord* record)
+    {
+        if (env != nullptr)
+        {
+            Napi::Object sample = Napi::Object::New(env);
+            Napi::Object steps = Napi::Object::New(env);
+            for (const ProfileRotary& rotary : record->profile->Rotaries())
+            {
+                std::string key = RotaryKey(rotary.name);
+                sample.Set(key, Napi::Number::New(env, record->delta[rotary.axis]));
+                steps.Set(key, Napi::Number::New(env, record->steps[rotary.axis]));
+            }
+            sample.Set("steps", steps);
+            sample.Set("held", SampleButtons(env, *record->profile, record->held));
+            sample.Set("pressed", SampleButtons(env, *record->profile, record->pressed));
+            sample.Set("timestamp", Napi::Number::New(env, record->timestampNs / 1e6));
+            sample.Set("missed", Napi::Number::New(env, record->missedTicks));
+
+            jsCallback.Call({ Napi::String::New(env, "sample"), sample });
         }
+        record->Delivered();
+        delete record;
+    };
+    if (!CallServer(owner, false, record, callback))
+    {
+        record->Delivered();
+        delete record;
+    }
+}
+
+// { name, count, timestamp, delta } for waitFor() and event streams
+static Napi::Object EventObject(Napi::Env env, const TourBoxEvent& ev)
+{
+    Napi::Object event = Napi::Object::New(env);
+    event.Set("name", Napi::String::New(env, EventName(ev.id)));
+    event.Set("count", Napi::Number::New(env, ev.count));
+    event.Set("timestamp", ev.timestampNs ? (Napi::Value)Napi::Number::New(env, ev.timestampNs / 1e6) : env.Undefined());
+    if (ev.hasValue) event.Set("delta", Napi::Number::New(env, ev.value));
+    return event;
+}
 
-        int serverId = g_nextServerId++;
-        g_servers[serverId] = server;
+// Events of a stream batch as an array; a `dropped` property counts events lost to a full queue
+static Napi::Array StreamBatchArray(Napi::Env env, const StreamBatch& batch)
+{
+    Napi::Array events = Napi::Array::New(env, batch.events.size());
+    for (uint32_t i = 0; i < batch.events.size(); i++)
+    {
+        events.Set(i, EventObject(env, batch.events[i]));
+    }
+    if (batch.dropped) events.Set("dropped", Napi::Number::New(env, batch.dropped));
+    return events;
+}
 
-        return Napi::Number::New(env, serverId);
-    } 
-	catch (const std::exception& e) 
-	{
-        Napi::Error::New(env, std::string("Server creation failed: ") + e.what())
-            .ThrowAsJavaScriptException();
-        return env.Null();
+// Settle waitFor() promises: matched waiters resolve with { name, count, timestamp, delta },
+// timed-out ones reject with an ETIMEDOUT error
+void DeliverWaiterResults(int owner, std::vector<WaiterResult>* results)
+{
+    auto callback = [](Napi::Env env, Napi::Function, std::vector<WaiterResult>* results)
+    {
+        if (env != nullptr)
+        {
+            for (const WaiterResult& result : *results)
+            {
+                auto it = g_waiters.find(result.waiterId);
+                if (it == g_waiters.end()) continue;
+
+                if (result.outcome == WaiterResult::Matched)
+                {
+                    it->second.deferred.Resolve(EventObject(env, result.event));
+                }
+                else
+                {
+                    Napi::Error error = Napi::Error::New(env, "Timed out waiting for '" + it->second.control + "'");
+                    error.Value().Set("code", Napi::String::New(env, "ETIMEDOUT"));
+                    it->second.deferred.Reject(error.Value());
+                }
+                g_waiters.erase(it);
+            }
+        }
+        delete results;
+    };
+    if (!CallServer(owner, false, results, callback))
+    {
+        // Still pending in g_waiters; StopServer rejects them
+        delete results;
     }
 }
 
-// Stop TourBox server
-Napi::Value StopServer(const Napi::CallbackInfo& info) 
+// Resolve a stream's pending streamNext() with the batch its pull armed
+void DeliverStreamBatch(int owner, StreamBatch* batch)
 {
-    Napi::Env env = info.Env();
+    auto callback = [](Napi::Env env, Napi::Function, StreamBatch* batch)
+    {
+        if (env != nullptr)
+        {
+            auto it = g_streamPulls.find(batch->streamId);
+            if (it != g_streamPulls.end())
+            {
+                it->second.deferred.Resolve(StreamBatchArray(env, *batch));
+                g_streamPulls.erase(it);
+            }
+        }
+        delete batch;
+    };
+    if (!CallServer(owner, false, batch, callback))
+    {
+        // Still pending in g_streamPulls; StopServer ends the stream
+        delete batch;
+    }
+}
 
-    if (info.Length() < 1 || !info[0].IsNumber()) 
-	{
-        Napi::TypeError::New(env, "Expected argument: (serverId: number)")
+// Read an optional non-negative integer option, keeping the current value when absent
+static bool ReadIntOption(Napi::Env env, Napi::Object obj, const char* key, int& value)
+{
+    if (!obj.Has(key)) return true;
+    Napi::Value v = obj.Get(key);
+    if (v.IsBoolean())
+    {
+        if (!v.As<Napi::Boolean>().Value()) value = 0;
+        return true;
+    }
+    if (!v.IsNumber() || v.As<Napi::Number>().Int32Value() < 0)
+    {
+        Napi::TypeError::New(env, std::string("Option '") + key + "' must be a non-negative number")
             .ThrowAsJavaScriptException();
-        return env.Null();
+        return false;
     }
+    value = v.As<Napi::Number>().Int32Value();
+    return true;
+}
 
-    int serverId = info[0].As<Napi::Number>().Int32Value();
-    
-    auto it = g_servers.find(serverId);
-    if (it != g_servers.end()) 
-	{
-        it->second->Stop();
-        g_servers.erase(it);
-        
-        if (g_eventCallback) 
-		{
-            g_eventCallback.Release();
+// Read { cpus, policy, priority, nice } into a thread placement, keeping fields that are absent
+static bool ReadThreadPlacement(Napi::Env env, Napi::Object obj, ThreadPlacement& placement)
+{
+    if (obj.Has("cpus"))
+    {
+        Napi::Value cpus = obj.Get("cpus");
+        if (!cpus.IsArray())
+        {
+            Napi::TypeError::New(env, "Option 'cpus' must be an array of CPU numbers")
+                .ThrowAsJavaScriptException();
+            return false;
         }
-        if (g_rawCallback) 
-		{
-            g_rawCallback.Release();
+        Napi::Array list = cpus.As<Napi::Array>();
+        placement.cpus.clear();
+        for (uint32_t i = 0; i < list.Length(); i++)
+        {
+            placement.cpus.push_back(list.Get(i).ToNumber().Int32Value());
         }
-        
-        return Napi::Boolean::New(env, true);
     }
 
-    return Napi::Boolean::New(env, false);
+    if (obj.Has("policy"))
+    {
+        std::string policy = obj.Get("policy").ToString().Utf8Value();
+        if (policy == "fifo") placement.policy = ThreadPolicy::Fifo;
+        else if (policy == "rr") placement.policy = ThreadPolicy::RoundRobin;
+        else if (policy == "other") placement.policy = ThreadPolicy::Default;
+        else
+        {
+            Napi::TypeError::New(env, "Option 'policy' must be 'fifo', 'rr' or 'other'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (obj.Has("priority")) placement.priority = obj.Get("priority").ToNumber().Int32Value();
+    if (obj.Has("nice"))
+    {
+        placement.setNice = true;
+        placement.nice = obj.Get("nice").ToNumber().Int32Value();
+    }
+    return true;
 }
 
-// Initialize the addon
-Napi::Object Init(Napi::Env env, Napi::Object exports) 
+// Read { curve, gain, slope, threshold, exponent, table, max } into an acceleration curve, keeping fields that are absent
+static bool ReadAccelerationCurve(Napi::Env env, Napi::Object obj, AccelerationCurve& curve)
 {
-    exports.Set(
-        Napi::String::New(env, "createServer"),
-        Napi::Function::New(env, CreateServer)
-    );
-    
-    exports.Set(
-        Napi::String::New(env, "stopServer"),
-        Napi::Function::New(env, StopServer)
-    );
+    if (obj.Has("curve"))
+    {
+        std::string type = obj.Get("curve").ToString().Utf8Value();
+        if (type == "linear") curve.type = AccelerationCurve::Linear;
+        else if (type == "power") curve.type = AccelerationCurve::Power;
+        else if (type == "table") curve.type = AccelerationCurve::Table;
+        else
+        {
+            Napi::TypeError::New(env, "Option 'curve' must be 'linear', 'power' or 'table'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
 
-    exports.Set(
-        Napi::String::New(env, "buttonState"),
-        Napi::Function::New(env, ButtonState)
+    if (obj.Has("gain")) curve.gain = obj.Get("gain").ToNumber().DoubleValue();
+    if (obj.Has("slope")) curve.slope = obj.Get("slope").ToNumber().DoubleValue();
+    if (obj.Has("threshold")) curve.threshold = obj.Get("threshold").ToNumber().DoubleValue();
+    if (obj.Has("exponent")) curve.exponent = obj.Get("exponent").ToNumber().DoubleValue();
+    if (obj.Has("max")) curve.maxMultiplier = obj.Get("max").ToNumber().DoubleValue();
+
+    if (obj.Has("table"))
+    {
+        // [[velocity, multiplier], ...]
+        Napi::Value table = obj.Get("table");
+        if (!table.IsArray())
+        {
+            Napi::TypeError::New(env, "Option 'table' must be an array of [velocity, multiplier] pairs")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        Napi::Array rows = table.As<Napi::Array>();
+        curve.table.clear();
+        for (uint32_t i = 0; i < rows.Length(); i++)
+        {
+            Napi::Value row = rows.Get(i);
+            if (!row.IsArray() || row.As<Napi::Array>().Length() < 2)
+            {
+                Napi::TypeError::New(env, "Option 'table' must be an array of [velocity, multiplier] pairs")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+            Napi::Array pair = row.As<Napi::Array>();
+            curve.table.push_back(std::make_pair(pair.Get((uint32_t)0).ToNumber().DoubleValue(),
+                                                 pair.Get((uint32_t)1).ToNumber().DoubleValue()));
+        }
+        std::sort(curve.table.begin(), curve.table.end());
+        if (!obj.Has("curve")) curve.type = AccelerationCurve::Table;
+    }
+    return true;
+}
+
+// Read { tap, doubleTap, longPress } (milliseconds, false = off) into gesture settings
+static bool ReadGestureSettings(Napi::Env env, Napi::Object obj, GestureSettings& settings)
+{
+    if (!ReadIntOption(env, obj, "tap", settings.tapMs)) return false;
+    if (!ReadIntOption(env, obj, "doubleTap", settings.doubleTapMs)) return false;
+    if (!ReadIntOption(env, obj, "longPress", settings.longPressMs)) return false;
+    return true;
+}
+
+// Read { delay, interval } (milliseconds) or { rate } (Hz) into repeat settings
+static bool ReadRepeatSettings(Napi::Env env, Napi::Object obj, RepeatSettings& settings)
+{
+    if (!ReadIntOption(env, obj, "delay", settings.delayMs)) return false;
+    if (!ReadIntOption(env, obj, "interval", settings.intervalMs)) return false;
+    if (obj.Has("rate"))
+    {
+        double rate = obj.Get("rate").ToNumber().DoubleValue();
+        if (rate <= 0 || rate > 1000)
+        {
+            Napi::TypeError::New(env, "Option 'rate' must be between 0 and 1000 repeats per second")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        settings.intervalMs = std::max(1, (int)(1000.0 / rate + 0.5));
+    }
+    return true;
+}
+
+// Read { name, controls: [...] } into a compiled device profile
+static bool ReadDeviceProfile(Napi::Env env, Napi::Value value, std::shared_ptr<DeviceProfile>& profile)
+{
+    if (!value.IsObject() || !value.As<Napi::Object>().Get("controls").IsArray())
+    {
+        Napi::TypeError::New(env, "Option 'profile' must be an object with a 'controls' array")
+            .ThrowAsJavaScriptException();
+        return false;
+    }
+
+    Napi::Object o = value.As<Napi::Object>();
+    Napi::Array controls = o.Get("controls").As<Napi::Array>();
+    profile = std::make_shared<DeviceProfile>();
+    if (o.Has("name")) profile->name = o.Get("name").ToString().Utf8Value();
+
+    // Codes are bytes; a missing optional code is -1
+    auto readCode = [&](Napi::Object control, const char* key, bool required, int& code) -> bool
+    {
+        code = -1;
+        Napi::Value v = control.Get(key);
+        if (v.IsUndefined() || v.IsNull())
+        {
+            if (!required) return true;
+        }
+        else if (v.IsNumber())
+        {
+            code = v.As<Napi::Number>().Int32Value();
+            if (code >= 0 && code < 256 && (double)code == v.As<Napi::Number>().DoubleValue()) return true;
+        }
+        Napi::TypeError::New(env, std::string("Profile control '") + control.Get("name").ToString().Utf8Value() +
+                             "': '" + key + "' must be a byte code (0-255)")
+            .ThrowAsJavaScriptException();
+        return false;
+    };
+    auto readName = [](Napi::Object control, const char* key, const std::string& fallback)
+    {
+        return control.Has(key) ? control.Get(key).ToString().Utf8Value() : fallback;
+    };
+
+    for (uint32_t i = 0; i < controls.Length(); i++)
+    {
+        Napi::Value entry = controls.Get(i);
+        if (!entry.IsObject() || !entry.As<Napi::Object>().Get("name").IsString())
+        {
+            Napi::TypeError::New(env, "Each profile control needs a 'name'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Object control = entry.As<Napi::Object>();
+        std::string name = control.Get("name").As<Napi::String>().Utf8Value();
+        std::string type = readName(control, "type", "button");
+        std::string error;
+        if (type == "button")
+        {
+            int press, release;
+            if (!readCode(control, "press", true, press) || !readCode(control, "release", false, release)) return false;
+            if (!profile->AddButton(name, press, release, readName(control, "pressName", name + " Press"),
+                                    readName(control, "releaseName", name + " Release"), error))
+            {
+                Napi::TypeError::New(env, "Profile control '" + name + "': " + error).ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        else if (type == "rotary")
+        {
+            int cw, ccw;
+            if (!readCode(control, "cw", true, cw) || !readCode(control, "ccw", true, ccw)) return false;
+            if (!profile->AddRotary(name, cw, ccw, readName(control, "cwName", name + " CW"),
+                                    readName(control, "ccwName", name + " CCW"), error))
+            {
+                Napi::TypeError::New(env, "Profile control '" + name + "': " + error).ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+        else
+        {
+            Napi::TypeError::New(env, "Profile control '" + name + "': 'type' must be 'button' or 'rotary'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    profile->Finish();
+    return true;
+}
+
+// Apply createServer options to a server before it starts
+// profile: { name, controls: [{ type: 'button', name, press, release, pressName, releaseName } | { type: 'rotary', name, cw, ccw, cwName, ccwName }] }
+// lowLatency: true | { noDelay, quickAck, rcvLowat, busyPoll, rcvBuf }
+// timestamps: true | 'ns' | 'timestamping'
+// threads: { name, cpus, policy, priority, nice, accept: {...}, io: {...}, dispatch: {...} }
+// gestures: true | { tap, doubleTap, longPress, buttons: { <Button>: false | { tap, doubleTap, longPress } } }
+// repeat: true | { delay, interval | rate, buttons: ['Up', ...] | { <Button>: true | false | { delay, interval, rate } } }
+// layers: [{ name, button, mode ('hold' | 'toggle'), map: { <control>: <event name> } }]
+// sequences: [{ name, steps: ['Up', { control: 'Down', within: 300 }, ...], window, timeout }]
+// sample: rate in Hz | { rate } | true (60 Hz)
+// encoders: [{ name, control (rotary: 'Knob' | 'Scroll' | 'Dial' | ...), min, max, step, value, wrap, notify }]
+// acceleration: true | 'linear' | 'power' | { curve, gain, slope, threshold, exponent, table, max, smoothing, reset, knob: {...}, scroll: {...}, dial: {...} }
+// embedded: true (no server threads; excludes sample, gestures, repeat, aggregate and decoderIdle)
+static bool ApplyServerOptions(Napi::Env env, Napi::Object options, TourBoxServerWrapper* server)
+{
+    // The profile comes first: every option below names controls through it
+    if (options.Has("profile") && !options.Get("profile").IsUndefined())
+    {
+        std::shared_ptr<DeviceProfile> profile;
+        if (!ReadDeviceProfile(env, options.Get("profile"), profile)) return false;
+        server->profiles.Publish(profile);
+    }
+    std::shared_ptr<const DeviceProfile> profile = server->profiles.Current();
+
+    if (options.Has("lowLatency"))
+    {
+        Napi::Value lowLatency = options.Get("lowLatency");
+        if (lowLatency.IsObject())
+        {
+            // Start from the low-latency profile and let each field override it
+            Napi::Object o = lowLatency.As<Napi::Object>();
+            ClientSocketOptions socketOptions = ClientSocketOptions::LowLatency();
+            if (o.Has("noDelay")) socketOptions.noDelay = o.Get("noDelay").ToBoolean().Value();
+            if (o.Has("quickAck")) socketOptions.quickAck = o.Get("quickAck").ToBoolean().Value();
+            if (!ReadIntOption(env, o, "rcvLowat", socketOptions.rcvLowat)) return false;
+            if (!ReadIntOption(env, o, "busyPoll", socketOptions.busyPollUs)) return false;
+            if (!ReadIntOption(env, o, "rcvBuf", socketOptions.rcvBufBytes)) return false;
+            server->clientSocketOptions = socketOptions;
+        }
+        else if (lowLatency.ToBoolean().Value())
+        {
+            server->clientSocketOptions = ClientSocketOptions::LowLatency();
+        }
+    }
+
+    if (options.Has("timestamps"))
+    {
+        Napi::Value timestamps = options.Get("timestamps");
+        std::string mode = timestamps.IsString() ? timestamps.As<Napi::String>().Utf8Value()
+                         : (timestamps.ToBoolean().Value() ? "ns" : "off");
+        if (mode == "ns") server->clientSocketOptions.rxTimestamps = RxTimestampMode::TimestampNs;
+        else if (mode == "timestamping") server->clientSocketOptions.rxTimestamps = RxTimestampMode::Timestamping;
+        else if (mode == "off") server->clientSocketOptions.rxTimestamps = RxTimestampMode::Off;
+        else
+        {
+            Napi::TypeError::New(env, "Option 'timestamps' must be true, false, 'ns' or 'timestamping'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (!ReadIntOption(env, options, "decoderIdle", server->decoderOptions.idleFlushMs)) return false;
+    if (!ReadIntOption(env, options, "decoderMaxHold", server->decoderOptions.maxHoldMs)) return false;
+
+    if (options.Has("aggregate"))
+    {
+        Napi::Value aggregate = options.Get("aggregate");
+        if (aggregate.IsObject() && !aggregate.IsArray()) aggregate = aggregate.As<Napi::Object>().Get("window");
+
+        if (aggregate.IsString() && aggregate.As<Napi::String>().Utf8Value() == "tick")
+        {
+            server->dispatcher.SetAggregationWindow(0);
+        }
+        else if (aggregate.IsNumber() && aggregate.As<Napi::Number>().DoubleValue() >= 0 && aggregate.As<Napi::Number>().DoubleValue() <= 1000)
+        {
+            server->dispatcher.SetAggregationWindow((int64_t)(aggregate.As<Napi::Number>().DoubleValue() * 1e6));
+        }
+        else if (aggregate.IsBoolean() || aggregate.IsUndefined() || aggregate.IsNull())
+        {
+            server->dispatcher.SetAggregationWindow(aggregate.ToBoolean().Value() ? 0 : -1);
+        }
+        else
+        {
+            Napi::TypeError::New(env, "Option 'aggregate' must be a window in milliseconds (0-1000) or 'tick'")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    if (options.Has("acceleration"))
+    {
+        Napi::Value acceleration = options.Get("acceleration");
+        AccelerationOptions& accel = server->accelerationOptions;
+        if (acceleration.IsObject())
+        {
+            // Top-level curve fields apply to every axis, per-rotary keys (knob / scroll / dial) refine them
+            Napi::Object o = acceleration.As<Napi::Object>();
+            AccelerationCurve curve;
+            curve.type = AccelerationCurve::Power;
+            if (!ReadAccelerationCurve(env, o, curve)) return false;
+            if (o.Has("smoothing")) accel.smoothing = o.Get("smoothing").ToNumber().DoubleValue();
+            if (!ReadIntOption(env, o, "reset", accel.resetMs)) return false;
+
+            for (auto& c : accel.curves) c = curve;
+            for (const ProfileRotary& rotary : profile->Rotaries())
+            {
+                std::string key = RotaryKey(rotary.name);
+                if (o.Has(key) && o.Get(key).IsObject())
+                {
+                    if (!ReadAccelerationCurve(env, o.Get(key).As<Napi::Object>(), accel.curves[rotary.axis])) return false;
+                }
+            }
+            accel.enabled = true;
+        }
+        else if (acceleration.IsString())
+        {
+            AccelerationCurve curve;
+            Napi::Object o = Napi::Object::New(env);
+            o.Set("curve", acceleration);
+            if (!ReadAccelerationCurve(env, o, curve)) return false;
+            for (auto& c : accel.curves) c = curve;
+            accel.enabled = true;
+        }
+        else if (acceleration.ToBoolean().Value())
+        {
+            AccelerationCurve curve;
+            curve.type = AccelerationCurve::Power;
+            for (auto& c : accel.curves) c = curve;
+            accel.enabled = true;
+        }
+        else
+        {
+            accel.enabled = false;
+        }
+    }
+
+    if (options.Has("gestures"))
+    {
+        Napi::Value gestures = options.Get("gestures");
+        GestureSettings defaults;
+        defaults.enabled = gestures.ToBoolean().Value();
+        Napi::Object buttons;
+        if (gestures.IsObject())
+        {
+            Napi::Object o = gestures.As<Napi::Object>();
+            if (!ReadGestureSettings(env, o, defaults)) return false;
+            if (o.Has("buttons") && o.Get("buttons").IsObject()) buttons = o.Get("buttons").As<Napi::Object>();
+        }
+
+        // Every button of the profile gets the defaults, refined per button
+        for (const ProfileButton& profileButton : profile->Buttons())
+        {
+            const std::string& button = profileButton.name;
+            GestureSettings settings = defaults;
+            if (defaults.enabled && !buttons.IsEmpty() && buttons.Has(button))
+            {
+                Napi::Value entry = buttons.Get(button);
+                if (entry.IsObject())
+                {
+                    if (!ReadGestureSettings(env, entry.As<Napi::Object>(), settings)) return false;
+                }
+                else
+                {
+                    settings.enabled = entry.ToBoolean().Value();
+                }
+            }
+            if (!server->gestures.Configure(profileButton.pressCode, button, settings))
+            {
+                Napi::RangeError::New(env, "Option 'gestures': no event id left for the gestures of '" + button + "', at most " +
+                                      std::to_string(kMaxEventIds) + " event names can exist")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+    }
+
+    if (options.Has("repeat"))
+    {
+        Napi::Value repeat = options.Get("repeat");
+        RepeatSettings defaults;
+        defaults.enabled = repeat.ToBoolean().Value();
+        Napi::Value buttons;
+        if (repeat.IsObject())
+        {
+            Napi::Object o = repeat.As<Napi::Object>();
+            if (!ReadRepeatSettings(env, o, defaults)) return false;
+            if (o.Has("buttons")) buttons = o.Get("buttons");
+        }
+
+        // The D-pad (as far as the profile has one) repeats unless a button list / map says otherwise
+        std::map<std::string, Napi::Value> selected;
+        if (buttons.IsArray())
+        {
+            Napi::Array list = buttons.As<Napi::Array>();
+            for (uint32_t i = 0; i < list.Length(); i++) selected[list.Get(i).ToString().Utf8Value()] = Napi::Boolean::New(env, true);
+        }
+        else if (buttons.IsObject())
+        {
+            Napi::Object map = buttons.As<Napi::Object>();
+            Napi::Array keys = map.GetPropertyNames();
+            for (uint32_t i = 0; i < keys.Length(); i++)
+            {
+                std::string key = keys.Get(i).ToString().Utf8Value();
+                selected[key] = map.Get(key);
+            }
+        }
+        else
+        {
+            for (const char* button : {"Up", "Down", "Left", "Right"})
+            {
+                if (profile->FindButton(button)) selected[button] = Napi::Boolean::New(env, true);
+            }
+        }
+
+        for (const auto& entry : selected)
+        {
+            const ProfileButton* button = profile->FindButton(entry.first);
+            if (!button)
+            {
+                Napi::TypeError::New(env, "Option 'repeat': unknown button '" + entry.first + "'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            RepeatSettings settings = defaults;
+            if (entry.second.IsObject())
+            {
+                if (!ReadRepeatSettings(env, entry.second.As<Napi::Object>(), settings)) return false;
+            }
+            else
+            {
+                settings.enabled = defaults.enabled && entry.second.ToBoolean().Value();
+            }
+            if (!server->repeater.Configure(button->pressCode, entry.first, settings))
+            {
+                Napi::RangeError::New(env, "Option 'repeat': no event id left for '" + entry.first + " Repeat', at most " +
+                                      std::to_string(kMaxEventIds) + " event names can exist")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+    }
+
+    if (options.Has("layers"))
+    {
+        Napi::Value list = options.Get("layers");
+        if (!list.IsArray())
+        {
+            Napi::TypeError::New(env, "Option 'layers' must be an array of layer definitions")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Array layers = list.As<Napi::Array>();
+        for (uint32_t i = 0; i < layers.Length(); i++)
+        {
+            Napi::Value entry = layers.Get(i);
+            if (!entry.IsObject())
+            {
+                Napi::TypeError::New(env, "Each layer needs a 'button'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            Napi::Object o = entry.As<Napi::Object>();
+            std::string button = o.Has("button") ? o.Get("button").ToString().Utf8Value() : "";
+            const ProfileButton* trigger = profile->FindButton(button);
+            if (!trigger)
+            {
+                Napi::TypeError::New(env, "Layer " + std::to_string(i + 1) + ": unknown button '" + button + "'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            std::string name = o.Has("name") ? o.Get("name").ToString().Utf8Value() : "Layer" + std::to_string(i + 2);
+            std::string mode = o.Has("mode") ? o.Get("mode").ToString().Utf8Value() : "hold";
+            if (mode != "hold" && mode != "toggle")
+            {
+                Napi::TypeError::New(env, "Layer '" + name + "': 'mode' must be 'hold' or 'toggle'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            int layer = server->layers.AddLayer(trigger->pressCode, mode == "toggle" ? LayerMode::Toggle : LayerMode::Hold);
+            if (layer < 0)
+            {
+                Napi::RangeError::New(env, "At most " + std::to_string(kMaxLayers - 1) + " layers can be defined")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            // Every control becomes "<layer>:<control>" unless the layer maps it to its own name
+            Napi::Object map = (o.Has("map") && o.Get("map").IsObject()) ? o.Get("map").As<Napi::Object>() : Napi::Object::New(env);
+            for (const std::string& control : profile->Controls())
+            {
+                std::string eventName = map.Has(control) ? map.Get(control).ToString().Utf8Value()
+                                                         : name + ":" + control;
+                uint16_t eventId;
+                if (!InternOptionName(env, "Layer '" + name + "'", eventName, eventId)) return false;
+                server->layers.Map(layer, profile->CodeOf(control), eventId);
+            }
+        }
+    }
+
+    if (options.Has("sequences"))
+    {
+        Napi::Value list = options.Get("sequences");
+        if (!list.IsArray())
+        {
+            Napi::TypeError::New(env, "Option 'sequences' must be an array of sequence definitions")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Array sequences = list.As<Napi::Array>();
+        for (uint32_t i = 0; i < sequences.Length(); i++)
+        {
+            Napi::Value entry = sequences.Get(i);
+            if (!entry.IsObject() || !entry.As<Napi::Object>().Has("name") || !entry.As<Napi::Object>().Get("steps").IsArray())
+            {
+                Napi::TypeError::New(env, "Each sequence needs a 'name' and an array of 'steps'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            Napi::Object o = entry.As<Napi::Object>();
+            SequenceDefinition definition;
+            std::string name = o.Get("name").ToString().Utf8Value();
+            if (!InternOptionName(env, "Sequence '" + name + "'", name, definition.eventId)) return false;
+            int timeoutMs = 0;
+            if (!ReadIntOption(env, o, "window", definition.windowMs)) return false;
+            if (!ReadIntOption(env, o, "timeout", timeoutMs)) return false;
+
+            // A step is an event name ("Knob CW", "Layer2:Up Press") or a button ("Up" = "Up Press"),
+            // optionally { control, within } to bound the gap before it
+            Napi::Array steps = o.Get("steps").As<Napi::Array>();
+            for (uint32_t s = 0; s < steps.Length(); s++)
+            {
+                Napi::Value step = steps.Get(s);
+                int withinMs = timeoutMs;
+                std::string control;
+                if (step.IsObject())
+                {
+                    Napi::Object stepObject = step.As<Napi::Object>();
+                    control = stepObject.Get("control").ToString().Utf8Value();
+                    if (!ReadIntOption(env, stepObject, "within", withinMs)) return false;
+                }
+                else
+                {
+                    control = step.ToString().Utf8Value();
+                }
+
+                // Controls resolve through the profile ("Up" -> "Up Press"); anything else (gestures, layer events) is taken as is
+                int code = ResolveControlCode(*profile, control);
+                uint16_t stepId;
+                if (code >= 0) stepId = profile->Lookup(code)->eventId;
+                else if (!InternOptionName(env, "Sequence '" + name + "'", control, stepId)) return false;
+                definition.steps.push_back(stepId);
+                if (s > 0) definition.stepTimeoutMs.push_back(withinMs);
+            }
+
+            if (!server->sequences.Add(definition))
+            {
+                Napi::RangeError::New(env, "Sequence '" + name + "' must have 1 to " + std::to_string(kMaxSequenceLength) + " steps")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+    }
+
+    if (options.Has("sample"))
+    {
+        Napi::Value sample = options.Get("sample");
+        if (sample.IsObject()) sample = sample.As<Napi::Object>().Get("rate");
+        double rate = sample.IsNumber() ? sample.As<Napi::Number>().DoubleValue() : (sample.ToBoolean().Value() ? 60 : 0);
+        if (rate < 0 || rate > 1000)
+        {
+            Napi::TypeError::New(env, "Option 'sample' must be a rate in Hz (1-1000)")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        if (rate > 0 && rate < 1) rate = 1;
+        server->sampler.SetRate(rate);
+    }
+
+    if (options.Has("encoders"))
+    {
+        Napi::Value list = options.Get("encoders");
+        if (!list.IsArray())
+        {
+            Napi::TypeError::New(env, "Option 'encoders' must be an array of encoder definitions")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+
+        Napi::Array encoders = list.As<Napi::Array>();
+        for (uint32_t i = 0; i < encoders.Length(); i++)
+        {
+            Napi::Value entry = encoders.Get(i);
+            if (!entry.IsObject() || !entry.As<Napi::Object>().Has("name"))
+            {
+                Napi::TypeError::New(env, "Each encoder needs at least a 'name' and a 'control'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            Napi::Object o = entry.As<Napi::Object>();
+            EncoderConfig config;
+            config.name = o.Get("name").ToString().Utf8Value();
+
+            std::string control = o.Has("control") ? o.Get("control").ToString().Utf8Value() : "";
+            config.axis = profile->AxisOf(control);
+            if (config.axis == (uint8_t)AxisNone)
+            {
+                Napi::TypeError::New(env, "Encoder '" + config.name + "': 'control' must be a rotary control such as 'Knob', 'Scroll' or 'Dial'")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+
+            if (o.Has("min")) config.min = o.Get("min").ToNumber().DoubleValue();
+            if (o.Has("max")) config.max = o.Get("max").ToNumber().DoubleValue();
+            if (o.Has("step")) config.step = o.Get("step").ToNumber().DoubleValue();
+            config.value = o.Has("value") ? o.Get("value").ToNumber().DoubleValue() : config.min;
+            if (o.Has("wrap")) config.wrap = o.Get("wrap").ToBoolean().Value();
+            if (o.Has("notify")) config.notify = o.Get("notify").ToBoolean().Value();
+
+            if (!InternOptionName(env, "Encoder '" + config.name + "'", config.name, config.eventId)) return false;
+            if (server->encoders.Add(config) < 0)
+            {
+                Napi::RangeError::New(env, "At most " + std::to_string(kMaxEncoders) + " encoders can be defined")
+                    .ThrowAsJavaScriptException();
+                return false;
+            }
+        }
+    }
+
+    if (options.Has("threads") && options.Get("threads").IsObject())
+    {
+        // Top-level fields apply to every thread, accept / io refine them
+        Napi::Object threads = options.Get("threads").As<Napi::Object>();
+        ThreadOptions& t = server->threadOptions;
+        if (threads.Has("name")) t.namePrefix = threads.Get("name").ToString().Utf8Value();
+        if (!ReadThreadPlacement(env, threads, t.accept)) return false;
+        t.io = t.accept;
+        t.dispatch = t.accept;
+        if (threads.Has("accept") && threads.Get("accept").IsObject())
+        {
+            if (!ReadThreadPlacement(env, threads.Get("accept").As<Napi::Object>(), t.accept)) return false;
+        }
+        if (threads.Has("io") && threads.Get("io").IsObject())
+        {
+            if (!ReadThreadPlacement(env, threads.Get("io").As<Napi::Object>(), t.io)) return false;
+        }
+        if (threads.Has("dispatch") && threads.Get("dispatch").IsObject())
+        {
+            if (!ReadThreadPlacement(env, threads.Get("dispatch").As<Napi::Object>(), t.dispatch)) return false;
+        }
+    }
+
+    // embedded: true - decode on the Node.js event loop; features that run on native threads are unavailable
+    if (options.Has("embedded")) server->embedded = options.Get("embedded").ToBoolean().Value();
+    if (server->embedded)
+    {
+        const char* threaded = server->sampler.Enabled() ? "sample"
+                             : server->gestures.Enabled() ? "gestures"
+                             : server->repeater.Enabled() ? "repeat"
+                             : server->dispatcher.Aggregating() ? "aggregate"
+                             : server->decoderOptions.idleFlushMs > 0 ? "decoderIdle" : nullptr;
+        if (threaded)
+        {
+            Napi::TypeError::New(env, std::string("Option '") + threaded + "' is not available in embedded mode")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Arguments of createServer() / startServerAsync() that are used once the server is configured
+struct ServerListen
+{
+    int port;
+    std::vector<std::string> addresses;
+    bool dualStack;
+    std::string ip;		// addresses joined for messages
+};
+
+// Parse (port, eventCallback, ip?, rawCallback?, options?), create the callbacks and a configured, not yet
+// started server. Null with a pending JavaScript exception on bad arguments or options.
+static std::shared_ptr<TourBoxServerWrapper> PrepareServer(const Napi::CallbackInfo& info, ServerListen& listen)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsFunction()) 
+	{
+        Napi::TypeError::New(env, "Expected arguments: (port: number, eventCallback: function, ip?: string | string[], rawCallback?: function, options?: object)")
+            .ThrowAsJavaScriptException();
+        return nullptr;
+    }
+
+    listen.port = info[0].As<Napi::Number>().Int32Value();
+    listen.dualStack = true;
+    Napi::Function eventCallback = info[1].As<Napi::Function>();
+    Napi::Function rawCallback;
+    
+    // Remaining arguments are optional: address(es), raw callback and options, in that order
+    size_t argIndex = 2;
+    if (info.Length() > argIndex && info[argIndex].IsString()) 
+    {
+        listen.addresses.push_back(info[argIndex].As<Napi::String>().Utf8Value());
+        argIndex++;
+    }
+    else if (info.Length() > argIndex && info[argIndex].IsArray())
+    {
+        Napi::Array list = info[argIndex].As<Napi::Array>();
+        for (uint32_t i = 0; i < list.Length(); i++)
+        {
+            Napi::Value entry = list.Get(i);
+            if (!entry.IsString())
+            {
+                Napi::TypeError::New(env, "Addresses must be strings")
+                    .ThrowAsJavaScriptException();
+                return nullptr;
+            }
+            listen.addresses.push_back(entry.As<Napi::String>().Utf8Value());
+        }
+        argIndex++;
+    }
+    if (listen.addresses.empty()) listen.addresses.push_back("127.0.0.1");
+
+    if (info.Length() > argIndex && (info[argIndex].IsFunction() || info[argIndex].IsUndefined() || info[argIndex].IsNull()))
+    {
+        if (info[argIndex].IsFunction()) rawCallback = info[argIndex].As<Napi::Function>();
+        argIndex++;
+    }
+
+    Napi::Object options = Napi::Object::New(env);
+    if (info.Length() > argIndex && info[argIndex].IsObject())
+    {
+        options = info[argIndex].As<Napi::Object>();
+        if (options.Has("dualStack")) listen.dualStack = options.Get("dualStack").ToBoolean().Value();
+    }
+
+    for (const auto& address : listen.addresses)
+    {
+        listen.ip += (listen.ip.empty() ? "" : ", ") + address;
+    }
+
+    try 
+	{
+        auto server = std::make_shared<TourBoxServerWrapper>();
+        
+        if (!server->Initialize()) 
+		{
+            Napi::Error::New(env, "Failed to initialize TourBox server")
+                .ThrowAsJavaScriptException();
+            return nullptr;
+        }
+
+        // The id is fixed before any thread starts, so everything delivered finds this server's callbacks
+        server->SetOwner(g_nextServerId++);
+        server->rawData = !rawCallback.IsEmpty();
+
+        if (!ApplyServerOptions(env, options, server.get()))
+        {
+            return nullptr;
+        }
+
+        if (server->embedded)
+        {
+            static bool cleanupHooked = false;
+            if (!cleanupHooked)
+            {
+                env.AddCleanupHook([]()
+                {
+                    g_inlineEventCallback.Reset();
+                    g_inlineRawCallback.Reset();
+                    for (auto& embedded : g_embedded)
+                    {
+                        embedded.second->eventCallback.Reset();
+                        embedded.second->rawCallback.Reset();
+                    }
+                    g_inlineContext.reset();
+                });
+                cleanupHooked = true;
+            }
+
+            g_inlineEnv = env;
+            g_inlineEventCallback = Napi::Persistent(eventCallback);
+            if (!rawCallback.IsEmpty()) g_inlineRawCallback = Napi::Persistent(rawCallback);
+            else g_inlineRawCallback.Reset();
+            if (!g_inlineContext) g_inlineContext.reset(new Napi::AsyncContext(env, "TourBoxEmbedded"));
+        }
+
+        // Created last: a thread-safe function keeps the event loop alive until it is released,
+        // so none may be left behind by a failure above
+        ServerCallbacks callbacks;
+        callbacks.event = Napi::ThreadSafeFunction::New(
+            env,
+            eventCallback,
+            "TourBoxEventCallback",
+            0,  // Unlimited queue
+            1   // One thread
+        );
+
+        // Create thread-safe raw callback if provided
+        if (!rawCallback.IsEmpty()) 
+		{
+            callbacks.raw = Napi::ThreadSafeFunction::New(
+                env,
+                rawCallback,
+                "TourBoxRawCallback",
+                0,  // Unlimited queue
+                1   // One thread
+            );
+        }
+
+        std::lock_guard<std::mutex> g(g_callbacksMutex);
+        g_callbacks[server->Owner()] = callbacks;
+        return server;
+    } 
+	catch (const std::exception& e) 
+	{
+        Napi::Error::New(env, std::string("Server creation failed: ") + e.what())
+            .ThrowAsJavaScriptException();
+        return nullptr;
+    }
+}
+
+// Release the callbacks of one server once none of its native threads can call them any more;
+// they are removed first, so a late delivery finds no callback instead of a finalized one
+static void ReleaseCallbacks(int serverId)
+{
+    ServerCallbacks callbacks;
+    {
+        std::lock_guard<std::mutex> g(g_callbacksMutex);
+        auto it = g_callbacks.find(serverId);
+        if (it == g_callbacks.end()) return;
+        callbacks = it->second;
+        g_callbacks.erase(it);
+    }
+    if (callbacks.event) callbacks.event.Release();
+    if (callbacks.raw) callbacks.raw.Release();
+}
+
+// Settle what a stopped server leaves behind: its waiters reject, its streams end, its handlers go
+static void SettleServerPromises(Napi::Env env, int serverId)
+{
+    // A batch still being delivered holds its own reference to the table
+    g_handlers.erase(serverId);
+
+    // Waiters of this server can no longer be matched
+    for (auto w = g_waiters.begin(); w != g_waiters.end();)
+    {
+        if (w->second.serverId != serverId)
+        {
+            ++w;
+            continue;
+        }
+        w->second.deferred.Reject(Napi::Error::New(env, "TourBox server stopped").Value());
+        w = g_waiters.erase(w);
+    }
+
+    // Its streams are closed; iterators waiting on them finish
+    for (auto p = g_streamPulls.begin(); p != g_streamPulls.end();)
+    {
+        if (p->second.serverId != serverId)
+        {
+            ++p;
+            continue;
+        }
+        p->second.deferred.Resolve(env.Null());
+        p = g_streamPulls.erase(p);
+    }
+}
+
+// { serverId, port, addresses: [{ address, family, port }] } of a started server, as read back with getsockname()
+static Napi::Object ServerInfo(Napi::Env env, int serverId, const TourBoxServerWrapper& server)
+{
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("serverId", Napi::Number::New(env, serverId));
+    result.Set("port", Napi::Number::New(env, server.GetPort()));
+
+    const std::vector<ListenAddress>& bound = server.GetAddresses();
+    Napi::Array addresses = Napi::Array::New(env, bound.size());
+    for (uint32_t i = 0; i < bound.size(); i++)
+    {
+        Napi::Object entry = Napi::Object::New(env);
+        entry.Set("address", Napi::String::New(env, bound[i].address));
+        entry.Set("family", Napi::String::New(env, bound[i].family == 6 ? "IPv6" : "IPv4"));
+        entry.Set("port", Napi::Number::New(env, bound[i].port));
+        addresses.Set(i, entry);
+    }
+    result.Set("addresses", addresses);
+    return result;
+}
+
+// Create TourBox server; returns ServerInfo (port 0 binds an ephemeral port)
+Napi::Value CreateServer(const Napi::CallbackInfo& info) 
+{
+    Napi::Env env = info.Env();
+
+    ServerListen listen;
+    std::shared_ptr<TourBoxServerWrapper> server = PrepareServer(info, listen);
+    if (!server) return env.Null();
+
+    if (!server->StartServer(listen.port, listen.addresses, listen.dualStack)) 
+	{
+        ReleaseCallbacks(server->Owner());
+        Napi::Error::New(env, "Failed to start TourBox server on " + listen.ip + ":" + std::to_string(listen.port) + ": " + server->GetLastError())
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = server->Owner();
+    g_servers[serverId] = server;
+    if (server->embedded) StartEmbedded(env, serverId, server);
+
+    return ServerInfo(env, serverId, *server);
+}
+
+/**
+ * Binds and starts a prepared server on a worker thread, so name resolution,
+ * bind() and the thread start-up stay off the JavaScript thread
+ */
+class StartServerWorker : public Napi::AsyncWorker
+{
+    public:
+        StartServerWorker(Napi::Env env, std::shared_ptr<TourBoxServerWrapper> server, const ServerListen& listen)
+            : Napi::AsyncWorker(env, "TourBoxStartServer"), server(server), listen(listen), deferred(env)
+        {
+        }
+
+        Napi::Promise Promise() const { return deferred.Promise(); }
+
+    protected:
+        void Execute() override
+        {
+            if (!server->StartServer(listen.port, listen.addresses, listen.dualStack))
+            {
+                SetError("Failed to start TourBox server on " + listen.ip + ":" + std::to_string(listen.port) + ": " + server->GetLastError());
+            }
+        }
+
+        void OnOK() override
+        {
+            int serverId = server->Owner();
+            g_servers[serverId] = server;
+            if (server->embedded) StartEmbedded(Env(), serverId, server);
+            deferred.Resolve(ServerInfo(Env(), serverId, *server));
+        }
+
+        void OnError(const Napi::Error& error) override
+        {
+            // Nothing was started, so nothing can still call the callbacks
+            ReleaseCallbacks(server->Owner());
+            deferred.Reject(error.Value());
+        }
+
+    private:
+        std::shared_ptr<TourBoxServerWrapper> server;
+        ServerListen listen;
+        Napi::Promise::Deferred deferred;
+};
+
+// startServerAsync(port, eventCallback, ip?, rawCallback?, options?) - Promise for ServerInfo,
+// resolved once every listener is bound and the server threads run
+Napi::Value StartServerAsync(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    ServerListen listen;
+    std::shared_ptr<TourBoxServerWrapper> server = PrepareServer(info, listen);
+    if (!server) return env.Null();
+
+    StartServerWorker* worker = new StartServerWorker(env, server, listen);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// Stop TourBox server
+Napi::Value StopServer(const Napi::CallbackInfo& info) 
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) 
+	{
+        Napi::TypeError::New(env, "Expected argument: (serverId: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    
+    auto it = g_servers.find(serverId);
+    if (it != g_servers.end()) 
+	{
+        // An embedded server may be stopped from one of its own callbacks; it finishes once that returns
+        if (!StopEmbedded(env, serverId)) it->second->Stop();
+        g_servers.erase(it);
+
+        SettleServerPromises(env, serverId);
+        ReleaseCallbacks(serverId);
+        
+        return Napi::Boolean::New(env, true);
+    }
+
+    return Napi::Boolean::New(env, false);
+}
+
+/**
+ * Stops a server on a worker thread: joining the accept, client and
+ * dispatch threads may take a while and must not stall the JavaScript thread
+ */
+class StopServerWorker : public Napi::AsyncWorker
+{
+    public:
+        StopServerWorker(Napi::Env env, std::shared_ptr<TourBoxServerWrapper> server)
+            : Napi::AsyncWorker(env, "TourBoxStopServer"), server(server), deferred(env)
+        {
+        }
+
+        Napi::Promise Promise() const { return deferred.Promise(); }
+
+    protected:
+        void Execute() override
+        {
+            server->Stop();
+        }
+
+        void OnOK() override
+        {
+            // Every producer has exited; callbacks already queued still run before the release takes effect.
+            // Only this server's callbacks go, others started meanwhile keep theirs.
+            ReleaseCallbacks(server->Owner());
+            server.reset();
+            deferred.Resolve(Napi::Boolean::New(Env(), true));
+        }
+
+    private:
+        std::shared_ptr<TourBoxServerWrapper> server;
+        Napi::Promise::Deferred deferred;
+};
+
+// stopServerAsync(serverId) - Promise resolved (true) once the server is fully torn down, false if unknown
+Napi::Value StopServerAsync(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber()) 
+	{
+        Napi::TypeError::New(env, "Expected argument: (serverId: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    auto it = g_servers.find(serverId);
+    if (it == g_servers.end())
+    {
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Resolve(Napi::Boolean::New(env, false));
+        return deferred.Promise();
+    }
+
+    // Unknown to the API from here on; results still in flight find nothing to settle
+    std::shared_ptr<TourBoxServerWrapper> server = it->second;
+    g_servers.erase(it);
+    SettleServerPromises(env, serverId);
+
+    // Embedded servers have no threads to join
+    if (StopEmbedded(env, serverId))
+    {
+        ReleaseCallbacks(serverId);
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Resolve(Napi::Boolean::New(env, true));
+        return deferred.Promise();
+    }
+
+    StopServerWorker* worker = new StopServerWorker(env, server);
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// encoders(serverId) - Float64Array over the server's encoder values (shared, not copied)
+Napi::Value Encoders(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected argument: (serverId: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+    if (it == g_servers.end()) return env.Null();
+
+    // The array keeps the storage alive, so it stays readable after stopServer()
+    auto* values = new std::shared_ptr<EncoderValues>(it->second->encoders.Values());
+    size_t count = it->second->encoders.Count();
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, (*values)->values, count * sizeof(double),
+        [](Napi::Env, void*, std::shared_ptr<EncoderValues>* hint) { delete hint; }, values);
+    return Napi::Float64Array::New(env, count, buffer, 0);
+}
+
+// setEncoder(serverId, index, value) - atomically set an encoder, limited to its range
+Napi::Value SetEncoder(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, index: number, value: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+    if (it == g_servers.end()) return Napi::Boolean::New(env, false);
+
+    return Napi::Boolean::New(env, it->second->encoders.Set(info[1].As<Napi::Number>().Int32Value(),
+                                                            info[2].As<Napi::Number>().DoubleValue()));
+}
+
+// setProfile(serverId, profile) - swap the device profile of a running server; connections stay up
+Napi::Value SetProfile(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, profile: object)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+    if (it == g_servers.end()) return Napi::Boolean::New(env, false);
+
+    std::shared_ptr<DeviceProfile> profile;
+    if (!ReadDeviceProfile(env, info[1], profile)) return env.Null();
+
+    // Client threads pick it up with their next packet; the old profile is freed once none can use it
+    it->second->profiles.Publish(profile);
+    return Napi::Boolean::New(env, true);
+}
+
+// waitFor(serverId, control, timeoutMs) - Promise for the next event of a control ("Tour" = "Tour Press")
+Napi::Value WaitFor(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, control: string, timeoutMs?: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    std::string control = info[1].As<Napi::String>().Utf8Value();
+    int64_t timeoutMs = (info.Length() > 2 && info[2].IsNumber()) ? info[2].As<Napi::Number>().Int64Value() : 0;
+
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    auto it = g_servers.find(serverId);
+    if (it == g_servers.end())
+    {
+        deferred.Reject(Napi::Error::New(env, "TourBox server is not running").Value());
+        return deferred.Promise();
+    }
+
+    // Controls resolve through the profile; other names (gestures, sequences, layer events) as given
+    TourBoxServerWrapper* server = it->second.get();
+    std::shared_ptr<const DeviceProfile> profile = server->profiles.Current();
+    int code = ResolveControlCode(*profile, control);
+    uint16_t eventId = 0;
+    if (code >= 0) eventId = profile->Lookup(code)->eventId;
+    else if (!FindEventName(control, eventId))
+    {
+        deferred.Reject(Napi::Error::New(env, "Unknown event '" + control + "'").Value());
+        return deferred.Promise();
+    }
+
+    uint64_t waiterId = g_nextWaiterId++;
+    g_waiters.emplace(waiterId, PendingWaiter{serverId, control, deferred});
+    if (!server->AddWaiter(waiterId, eventId, timeoutMs))
+    {
+        g_waiters.erase(waiterId);
+        deferred.Reject(Napi::Error::New(env, "TourBox server is not running").Value());
+    }
+    return deferred.Promise();
+}
+
+// openStream(serverId, controls, batch) - open a pull-driven event stream (empty controls = every event)
+Napi::Value OpenStream(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, controls: string[], batch?: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+    if (it == g_servers.end()) return env.Null();
+
+    int batch = 0;
+    if (info.Length() > 2 && info[2].IsNumber())
+    {
+        batch = info[2].As<Napi::Number>().Int32Value();
+        if (batch < 0)
+        {
+            Napi::TypeError::New(env, "batch must be a non-negative number").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+
+    // Same resolution as waitFor(): "Tour" is "Tour Press", other names must be known events
+    TourBoxServerWrapper* server = it->second.get();
+    std::shared_ptr<const DeviceProfile> profile = server->profiles.Current();
+    Napi::Array controls = info[1].As<Napi::Array>();
+    std::vector<uint16_t> ids;
+    for (uint32_t i = 0; i < controls.Length(); i++)
+    {
+        std::string control = controls.Get(i).ToString().Utf8Value();
+        int code = ResolveControlCode(*profile, control);
+        uint16_t eventId = 0;
+        if (code >= 0) eventId = profile->Lookup(code)->eventId;
+        else if (!FindEventName(control, eventId))
+        {
+            Napi::TypeError::New(env, "Unknown event '" + control + "'").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        ids.push_back(eventId);
+    }
+    return Napi::Number::New(env, (double)server->streams.Open(ids, (size_t)batch));
+}
+
+// streamNext(serverId, streamId) - Promise for the next batch of a stream (an array), or null once it is closed
+Napi::Value StreamNext(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, streamId: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    uint64_t streamId = (uint64_t)info[1].As<Napi::Number>().Int64Value();
+
+    Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+    auto it = g_servers.find(serverId);
+    if (it == g_servers.end() || g_streamPulls.count(streamId))
+    {
+        deferred.Resolve(env.Null());
+        return deferred.Promise();
+    }
+
+    // Register before pulling: a batch armed by this pull may be delivered from another thread at once
+    g_streamPulls.emplace(streamId, PendingPull{serverId, deferred});
+    StreamBatch batch;
+    switch (it->second->streams.Pull(streamId, batch))
+    {
+        case EventStreams::Ready:
+            g_streamPulls.erase(streamId);
+            deferred.Resolve(StreamBatchArray(env, batch));
+            break;
+        case EventStreams::Closed:
+            g_streamPulls.erase(streamId);
+            deferred.Resolve(env.Null());
+            break;
+        case EventStreams::Waiting:
+            break;
+    }
+    return deferred.Promise();
+}
+
+// closeStream(serverId, streamId) - close a stream; a pending streamNext() resolves with null
+Napi::Value CloseStream(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, streamId: number)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint64_t streamId = (uint64_t)info[1].As<Napi::Number>().Int64Value();
+    auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+    if (it != g_servers.end()) it->second->streams.Close(streamId);
+
+    auto pull = g_streamPulls.find(streamId);
+    if (pull != g_streamPulls.end())
+    {
+        pull->second.deferred.Resolve(env.Null());
+        g_streamPulls.erase(pull);
+    }
+    return Napi::Boolean::New(env, it != g_servers.end());
+}
+
+// Handlers and listener interest of a server, created on first use (JavaScript thread only)
+static std::shared_ptr<ServerHandlers>& HandlersOf(Napi::Env env, int serverId)
+{
+    // References must be gone before the environment is, not at static destruction
+    static bool cleanupHooked = false;
+    if (!cleanupHooked)
+    {
+        env.AddCleanupHook([]() { g_handlers.clear(); });
+        cleanupHooked = true;
+    }
+
+    std::shared_ptr<ServerHandlers>& handlers = g_handlers[serverId];
+    if (!handlers) handlers = std::make_shared<ServerHandlers>();
+    return handlers;
+}
+
+// Let through what listeners or handlers want: a '*' listener or catch-all takes everything
+static void ApplyEventFilter(TourBoxServerWrapper* server, const ServerHandlers& handlers)
+{
+    EventFilter& filter = server->dispatcher.Filter();
+    if (handlers.listenedAll || !handlers.catchAll.IsEmpty())
+    {
+        filter.SetAll();
+        return;
+    }
+
+    std::vector<uint16_t> ids;
+    for (int id = 0; id < kMaxEventIds; id++)
+    {
+        if (handlers.listened[id] || !handlers.byId[id].IsEmpty()) ids.push_back((uint16_t)id);
+    }
+    filter.Set(ids);
+}
+
+// registerHandler(serverId, control, fn | null) - call fn(count[, timestamp[, delta]]) directly for a control's events,
+// or fn(name, count, ...) for every event when control is '*'; null removes the handler. false for unknown names
+Napi::Value RegisterHandler(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsString() ||
+        !(info[2].IsFunction() || info[2].IsNull() || info[2].IsUndefined()))
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, control: string, handler: function | null)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    auto it = g_servers.find(serverId);
+    if (it == g_servers.end()) return Napi::Boolean::New(env, false);
+
+    // A name no event carries could never be called, so it is not given an id
+    std::string control = info[1].As<Napi::String>().Utf8Value();
+    uint16_t eventId = 0;
+    if (control != "*" && !FindEventName(control, eventId)) return Napi::Boolean::New(env, false);
+
+    ServerHandlers& handlers = *HandlersOf(env, serverId);
+    Napi::FunctionReference& slot = control == "*" ? handlers.catchAll : handlers.byId[eventId];
+    if (info[2].IsFunction())
+    {
+        slot = Napi::Persistent(info[2].As<Napi::Function>());
+    }
+    else
+    {
+        slot.Reset();
+    }
+    ApplyEventFilter(it->second.get(), handlers);
+    return Napi::Boolean::New(env, true);
+}
+
+// subscribe(serverId, names | true) - the events EventEmitter listeners exist for (true = all); the rest are
+// dropped natively unless a handler takes them
+Napi::Value Subscribe(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsNumber() || !(info[1].IsArray() || info[1].IsBoolean()))
+    {
+        Napi::TypeError::New(env, "Expected arguments: (serverId: number, names: string[] | true)")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    int serverId = info[0].As<Napi::Number>().Int32Value();
+    auto it = g_servers.find(serverId);
+    if (it == g_servers.end()) return Napi::Boolean::New(env, false);
+
+    ServerHandlers& handlers = *HandlersOf(env, serverId);
+    handlers.listened.assign(kMaxEventIds, false);
+    handlers.listenedAll = info[1].IsBoolean() && info[1].As<Napi::Boolean>().Value();
+
+    // Only names that already have an id can be delivered; the rest (other emitter events, typos)
+    // stay out of the id table. setProfile() re-subscribes, so events a new profile adds are picked up.
+    if (info[1].IsArray())
+    {
+        Napi::Array names = info[1].As<Napi::Array>();
+        for (uint32_t i = 0; i < names.Length(); i++)
+        {
+            uint16_t id;
+            if (FindEventName(names.Get(i).ToString().Utf8Value(), id)) handlers.listened[id] = true;
+        }
+    }
+    ApplyEventFilter(it->second.get(), handlers);
+    return Napi::Boolean::New(env, true);
+}
+
+// controls([serverId]) - event names of a server's active profile, or of the built-in profile
+Napi::Value Controls(const Napi::CallbackInfo& info)
+{
+    Napi::Env env = info.Env();
+
+    std::shared_ptr<const DeviceProfile> profile = DeviceProfile::Builtin();
+    if (info.Length() > 0 && info[0].IsNumber())
+    {
+        auto it = g_servers.find(info[0].As<Napi::Number>().Int32Value());
+        if (it != g_servers.end()) profile = it->second->profiles.Current();
+    }
+
+    Napi::Array names = Napi::Array::New(env, profile->Controls().size());
+    for (uint32_t i = 0; i < profile->Controls().size(); i++)
+    {
+        names.Set(i, Napi::String::New(env, profile->Controls()[i]));
+    }
+    return names;
+}
+
+// Initialize the addon
+Napi::Object Init(Napi::Env env, Napi::Object exports) 
+{
+    exports.Set(
+        Napi::String::New(env, "createServer"),
+        Napi::Function::New(env, CreateServer)
+    );
+    
+    exports.Set(
+        Napi::String::New(env, "stopServer"),
+        Napi::Function::New(env, StopServer)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "buttonState"),
+        Napi::Function::New(env, ButtonState)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "encoders"),
+        Napi::Function::New(env, Encoders)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "setEncoder"),
+        Napi::Function::New(env, SetEncoder)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "setProfile"),
+        Napi::Function::New(env, SetProfile)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "controls"),
+        Napi::Function::New(env, Controls)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "subscribe"),
+        Napi::Function::New(env, Subscribe)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "registerHandler"),
+        Napi::Function::New(env, RegisterHandler)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "startServerAsync"),
+        Napi::Function::New(env, StartServerAsync)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "stopServerAsync"),
+        Napi::Function::New(env, StopServerAsync)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "waitFor"),
+        Napi::Function::New(env, WaitFor)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "openStream"),
+        Napi::Function::New(env, OpenStream)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "streamNext"),
+        Napi::Function::New(env, StreamNext)
+    );
+
+    exports.Set(
+        Napi::String::New(env, "closeStream"),
+        Napi::Function::New(env, CloseStream)
     );
 
     return exports;
@@ -1,18 +1,25 @@
 #include "tourbox_client.h"
+#include "tourbox_timer.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
 
 const bool DEBUG = false; // Disable debug output for Node.js addon
 
 /**
  * Constructor - Initialize TourBox client wrapper with socket connection
  * @param socket The socket handle for the connected TourBox device
- * Sets up the client state and initializes the control mapping table
+ * Sets up the client state; the device profile is loaded by Run()
  */
-TourBoxClientWrapper::TourBoxClientWrapper(socket_t socket, TourBoxServerWrapper* srv) : clientSocket(socket), running(true), server(srv)
+TourBoxClientWrapper::TourBoxClientWrapper(socket_t socket, TourBoxServerWrapper* srv) : clientSocket(socket), running(true), server(srv),
+      profile(nullptr), rcuReader(nullptr), rxTimestampNs(0),
+      groupValue(-1), groupCount(0), groupTimestampNs(0), groupOpenedNs(0), eventTimestampNs(0),
+      rxArrivalNs(0), groupArrivalNs(0), eventArrivalNs(0)
 {
-    initializeControlMap();
+    if (server) eventSource = server->dispatcher.Register();
 }
 
 /**
@@ -27,70 +34,6 @@ TourBoxClientWrapper::~TourBoxClientWrapper()
     }
 }
 
-/**
- * Initialize Control Mapping Table
- * Maps TourBox protocol bytes to control actions with Node.js event emission
- * Creates the complete mapping of all TourBox controls including:
- * - Rotation controls (knob, dial, scroll wheel)
- * - Press/release button pairs with state tracking
- * - All C1-C4, T1-T2, and directional buttons
- */
-void TourBoxClientWrapper::initializeControlMap() 
-{
-    controlMap = 
-	{
-        // Rotation controls (no press/release) - emit events to Node.js
-        {132, ControlAction("Knob CCW",       false, -1, [](int count) { EmitToNode("Knob CCW", count); })},
-        {196, ControlAction("Knob CW",        false, -1, [](int count) { EmitToNode("Knob CW", count); })},
-        {137, ControlAction("Scroll Down",    false, -1, [](int count) { EmitToNode("Scroll Down", count); })},
-        {201, ControlAction("Scroll Up",      false, -1, [](int count) { EmitToNode("Scroll Up", count); })},
-        {143, ControlAction("Dial CCW",       false, -1, [](int count) { EmitToNode("Dial CCW", count); })},
-        {207, ControlAction("Dial CW",        false, -1, [](int count) { EmitToNode("Dial CW", count); })},
-        
-        // Knob press/release
-        {55,  ControlAction("Knob Press",     true, 183, [](int count) { EmitToNode("Knob Press", count); })},
-        {183, ControlAction("Knob Release",   false, -1, [](int count) { EmitToNode("Knob Release", count); })},
-        
-        // Dial press/release
-        {56,  ControlAction("Dial Press",     true, 184, [](int count) { EmitToNode("Dial Press", count); })},
-        {184, ControlAction("Dial Release",   false, -1, [](int count) { EmitToNode("Dial Release", count); })},
-        
-        // Directional buttons press/release
-        {16,  ControlAction("Up Press",       true, 144, [](int count) { EmitToNode("Up Press", count); })},
-        {144, ControlAction("Up Release",     false, -1, [](int count) { EmitToNode("Up Release", count); })},
-        {17,  ControlAction("Down Press",     true, 145, [](int count) { EmitToNode("Down Press", count); })},
-        {145, ControlAction("Down Release",   false, -1, [](int count) { EmitToNode("Down Release", count); })},
-        {18,  ControlAction("Left Press",     true, 146, [](int count) { EmitToNode("Left Press", count); })},
-        {146, ControlAction("Left Release",   false, -1, [](int count) { EmitToNode("Left Release", count); })},
-        {19,  ControlAction("Right Press",    true, 147, [](int count) { EmitToNode("Right Press", count); })},
-        {147, ControlAction("Right Release",  false, -1, [](int count) { EmitToNode("Right Release", count); })},
-        
-        // Side buttons press/release
-        {0,   ControlAction("Tall Press",     true, 128, [](int count) { EmitToNode("Tall Press", count); })},
-        {128, ControlAction("Tall Release",   false, -1, [](int count) { EmitToNode("Tall Release", count); })},
-        {1,   ControlAction("Side Press",     true, 129, [](int count) { EmitToNode("Side Press", count); })},
-		{129, ControlAction("Side Release",   false, -1, [](int count) { EmitToNode("Side Release", count); })},
-        {2,   ControlAction("Top Press",      true, 130, [](int count) { EmitToNode("Top Press", count); })},
-        {130, ControlAction("Top Release",    false, -1, [](int count) { EmitToNode("Top Release", count); })},
-        {3,   ControlAction("Short Press",    true, 131, [](int count) { EmitToNode("Short Press", count); })},
-        {131, ControlAction("Short Release",  false, -1, [](int count) { EmitToNode("Short Release", count); })},
-        
-        // Tour button press/release
-        {42,  ControlAction("Tour Press",     true, 170, [](int count) { EmitToNode("Tour Press", count); })},
-        {170, ControlAction("Tour Release",   false, -1, [](int count) { EmitToNode("Tour Release", count); })},
-        
-        // C1/C2 buttons press/release
-        {34,  ControlAction("C1 Press",       true, 162, [](int count) { EmitToNode("C1 Press", count); })},
-        {162, ControlAction("C1 Release",     false, -1, [](int count) { EmitToNode("C1 Release", count); })},
-        {35,  ControlAction("C2 Press",       true, 163, [](int count) { EmitToNode("C2 Press", count); })},
-        {163, ControlAction("C2 Release",     false, -1, [](int count) { EmitToNode("C2 Release", count); })},
-        
-        // Scroll press/release
-        {10,  ControlAction("Scroll Press",   true, 138, [](int count) { EmitToNode("Scroll Press", count); })},
-        {138, ControlAction("Scroll Release", false, -1, [](int count) { EmitToNode("Scroll Release", count); })}
-    };
-}
-
 /**
  * Main Client Loop - Handle incoming TourBox data
  * Continuously receives data from the TourBox device socket and processes it
@@ -100,10 +43,27 @@ void TourBoxClientWrapper::initializeControlMap()
 void TourBoxClientWrapper::Run() 
 {
     char buffer[1024];
+    int idleFlushMs = server ? server->decoderOptions.idleFlushMs : 0;
+    int maxHoldMs = server ? server->decoderOptions.maxHoldMs : 0;
+    Begin();
     
     while (running) 
 	{
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
+        // No profile reference is held while blocked, so a quiet device never holds up a swap
+        if (rcuReader) rcuReader->Offline();
+
+        // A run of rotation bytes is still open: flush it if the stream goes quiet,
+        // or once it has been held for maxHoldMs even though data keeps coming
+        if (groupValue >= 0 && idleFlushMs > 0 && !waitForData(holdTimeoutMs(idleFlushMs, maxHoldMs)))
+        {
+            refreshProfile();
+            flushGroup();
+            if (server) server->dispatcher.Notify();
+            continue;
+        }
+
+        int bytesReceived = receive(buffer, sizeof(buffer) - 1);
+        refreshProfile();
         
         if (bytesReceived <= 0) 
 		{
@@ -118,7 +78,248 @@ void TourBoxClientWrapper::Run()
             break;
         }
 
-        processData(buffer, bytesReceived);
+        handlePacket(buffer, bytesReceived);
+    }
+
+    Finish();
+}
+
+/**
+ * Prepare to Decode
+ * Joins the profile's RCU domain; Run() calls it, embedded mode calls it
+ * before the first Poll()
+ */
+void TourBoxClientWrapper::Begin()
+{
+    if (server) rcuReader = server->profiles.Rcu().RegisterReader();
+}
+
+/**
+ * Read and Decode One Packet Without Blocking (embedded mode)
+ * @return false once the connection is closed or failed; call Finish() then
+ *
+ * For a non-blocking socket polled by the owner's event loop. Events are
+ * delivered before it returns, and no profile reference is held afterwards.
+ */
+bool TourBoxClientWrapper::Poll()
+{
+    char buffer[1024];
+    if (rcuReader) rcuReader->Offline();
+
+    int bytesReceived = receive(buffer, sizeof(buffer) - 1);
+    if (bytesReceived < 0)
+    {
+#ifdef _WIN32
+        if (WSAGetLastError() == WSAEWOULDBLOCK) return true;
+#else
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return true;
+#endif
+        if (DEBUG) std::cerr << "Recv failed. Error: " << SOCKET_ERROR_CODE << std::endl;
+        return false;
+    }
+    if (bytesReceived == 0)
+    {
+        if (DEBUG) std::cout << "TourBox Console disconnected" << std::endl;
+        return false;
+    }
+
+    refreshProfile();
+    handlePacket(buffer, bytesReceived);
+    if (rcuReader) rcuReader->Offline();
+    return true;
+}
+
+/**
+ * Connection Ended
+ * Emits the open run, leaves the RCU domain, releases held buttons and
+ * waits until everything decoded has been handed to Node.js
+ */
+void TourBoxClientWrapper::Finish()
+{
+    // Emit whatever run was still open when the connection ended
+    refreshProfile();
+    flushGroup();
+    if (rcuReader)
+    {
+        rcuReader->Offline();
+        server->profiles.Rcu().UnregisterReader(rcuReader);
+        rcuReader = nullptr;
+    }
+
+    // Buttons still down belong to a device that is gone: clear them so
+    // held state, auto-repeat and pending gestures stop right away
+    if (server)
+    {
+        for (int code : heldCodes)
+        {
+            server->SetButtonHeld(code, false);
+            server->gestures.Cancel(code);
+            server->layers.OnRelease(code);
+        }
+        heldCodes.clear();
+    }
+
+    // Wait until everything this connection decoded has been handed to Node.js
+    if (server) server->dispatcher.Unregister(eventSource);
+}
+
+/**
+ * Receive With the Configured Method
+ * @return Bytes received, 0 on disconnect, negative on error (same as recv)
+ */
+int TourBoxClientWrapper::receive(char* buffer, int length)
+{
+    bool timestamped = server && server->clientSocketOptions.rxTimestamps != RxTimestampMode::Off;
+    return timestamped ? receiveTimestamped(buffer, length) : recv(clientSocket, buffer, length, 0);
+}
+
+/**
+ * Decode a Received Packet
+ * @param buffer Packet bytes
+ * @param bytesReceived Number of bytes
+ */
+void TourBoxClientWrapper::handlePacket(char* buffer, int bytesReceived)
+{
+    // Velocity is estimated from packet arrival, so stamp it here on the recv thread
+    if (server && server->accelerationOptions.enabled)
+    {
+        rxArrivalNs = rxTimestampNs ? rxTimestampNs : steadyNowNs();
+    }
+
+#ifdef TCP_QUICKACK
+    // Linux clears quick-ack mode after delayed ACKs resume, so re-arm it per read
+    if (server && server->clientSocketOptions.quickAck)
+    {
+        int one = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+    }
+#endif
+
+    processData(buffer, bytesReceived);
+}
+
+/**
+ * Receive Data Together With Its Arrival Time
+ * @param buffer Destination buffer
+ * @param length Maximum number of bytes to read
+ * @return Bytes received, 0 on disconnect, negative on error (same as recv)
+ *
+ * Uses recvmsg() and reads the kernel receive timestamp (SO_TIMESTAMPNS or
+ * SO_TIMESTAMPING) from the control message into rxTimestampNs, so event
+ * times exclude scheduler wake-up and decode delay. Falls back to the
+ * user-space clock when the kernel provides no timestamp.
+ */
+int TourBoxClientWrapper::receiveTimestamped(char* buffer, int length)
+{
+    int64_t kernelNs = 0;
+    int bytesReceived;
+
+#ifdef __linux__
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = length;
+
+    // Room for either a single timespec or the three of scm_timestamping
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(timespec))];
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    bytesReceived = (int)recvmsg(clientSocket, &msg, 0);
+    if (bytesReceived > 0)
+    {
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET) continue;
+
+            timespec ts[3];
+            memset(ts, 0, sizeof(ts));
+            if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                memcpy(&ts[0], CMSG_DATA(cmsg), sizeof(timespec));
+            }
+            else if (cmsg->cmsg_type == SCM_TIMESTAMPING)
+            {
+                // ts[0] is the software stamp (CLOCK_REALTIME); ts[2] would be the NIC's own
+                // clock, a different time base, so it is not requested or used
+                memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+            }
+            else
+            {
+                continue;
+            }
+
+            if (ts[0].tv_sec || ts[0].tv_nsec)
+            {
+                kernelNs = (int64_t)ts[0].tv_sec * 1000000000LL + ts[0].tv_nsec;
+            }
+        }
+    }
+#else
+    bytesReceived = recv(clientSocket, buffer, length, 0);
+#endif
+
+    if (bytesReceived > 0)
+    {
+        rxTimestampNs = kernelNs ? kernelNs : (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (DEBUG && !kernelNs) std::cout << "No kernel receive timestamp, using user-space clock" << std::endl;
+    }
+    return bytesReceived;
+}
+
+/**
+ * How Long the Open Rotation Run May Still Be Held
+ * @param idleFlushMs decoderOptions.idleFlushMs
+ * @param maxHoldMs decoderOptions.maxHoldMs (0 = no cap)
+ * @return Milliseconds to wait for more data, 0 once the run must be flushed
+ */
+int TourBoxClientWrapper::holdTimeoutMs(int idleFlushMs, int maxHoldMs) const
+{
+    if (maxHoldMs <= 0 || groupOpenedNs == 0) return idleFlushMs;
+    int64_t remainingNs = groupOpenedNs + (int64_t)maxHoldMs * 1000000 - steadyNowNs();
+    if (remainingNs <= 0) return 0;
+    int remainingMs = (int)((remainingNs + 999999) / 1000000);
+    return std::min(idleFlushMs, remainingMs);
+}
+
+/**
+ * Wait for the Socket to Become Readable
+ * @param timeoutMs Maximum time to wait
+ * @return true if data (or a disconnect / error) is ready, false on timeout
+ */
+bool TourBoxClientWrapper::waitForData(int timeoutMs)
+{
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(clientSocket, &readSet);
+
+    timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+    return select((int)clientSocket + 1, &readSet, nullptr, nullptr, &tv) != 0;
+}
+
+/**
+ * Load the Active Profile
+ * Marks this thread online first, so the profile it loads cannot be
+ * reclaimed before the thread next goes offline
+ */
+void TourBoxClientWrapper::refreshProfile()
+{
+    if (rcuReader)
+    {
+        rcuReader->Online();
+        profile = server->profiles.Read();
+    }
+    else
+    {
+        profile = DeviceProfile::Builtin().get();
     }
 }
 
@@ -139,21 +340,27 @@ void TourBoxClientWrapper::Stop()
  */
 void TourBoxClientWrapper::processData(char* buffer, int bytesReceived) 
 {
-    // Emit raw data to Node.js
-    EmitRawData(buffer, bytesReceived);
-    
-    //Debug display
-    std::stringstream hexStream;    
-    for (int i = 0; i < bytesReceived; i++) 
-	{
-        hexStream << std::hex << std::setw(2) << std::setfill('0') 
-                 << (int)(unsigned char)buffer[i];
+    // Queue raw data for Node.js
+    if (server && server->rawData)
+    {
+        TourBoxEvent ev = {};
+        ev.kind = EventKind::Raw;
+        ev.count = bytesReceived;
+        ev.timestampNs = rxTimestampNs;
+        ev.raw = new std::vector<uint8_t>(buffer, buffer + bytesReceived);
+        server->dispatcher.Push(*eventSource, ev);
     }
-    std::string hexData = hexStream.str();
     
+    //Debug display
     if (DEBUG) 
 	{
-        std::cout << "Raw hex data: " << hexData << " (length: " << bytesReceived << " bytes)" << std::endl;
+        std::stringstream hexStream;    
+        for (int i = 0; i < bytesReceived; i++) 
+        {
+            hexStream << std::hex << std::setw(2) << std::setfill('0') 
+                     << (int)(unsigned char)buffer[i];
+        }
+        std::cout << "Raw hex data: " << hexStream.str() << " (length: " << bytesReceived << " bytes)" << std::endl;
         
         // Show decimal values of each byte
         std::cout << "Byte values: ";
@@ -164,88 +371,84 @@ void TourBoxClientWrapper::processData(char* buffer, int bytesReceived)
         std::cout << std::endl;
     }
 
-    parseTourBoxData(hexData);
+    parseTourBoxData((const unsigned char*)buffer, bytesReceived);
+
+    // One wake-up per packet, however many events it decoded to
+    if (server) server->dispatcher.Notify();
 }
 
 /**
  * Parse TourBox Protocol Data
- * @param hexData Hex string representation of the received bytes
+ * @param bytes Received bytes
+ * @param length Number of bytes
  * 
- * Implements sequential processing to group consecutive identical bytes
- * This preserves timing information for rapid control actions
+ * Streaming decoder that groups consecutive identical bytes into one input
+ * with a count. The open group is kept on the client between calls, so a
+ * run split across TCP segments still becomes a single event. A group is
+ * flushed when a different byte arrives; at the end of the packet unless it
+ * is a rotation run and decoderOptions.idleFlushMs is set, in which case
+ * Run() flushes it after that much idle time, or once it has been open for
+ * decoderOptions.maxHoldMs.
  */
-void TourBoxClientWrapper::parseTourBoxData(const std::string& hexData) 
+void TourBoxClientWrapper::parseTourBoxData(const unsigned char* bytes, int length) 
 {
-    try 
-	{
-        // Sequential processing - group consecutive identical bytes
-        std::vector<int> bytes;
-        
-        // Convert hex string to byte values
-        for (size_t i = 0; i < hexData.length(); i += 2) 
-		{
-            if (i + 1 < hexData.length()) 
-			{
-                std::string byteHex = hexData.substr(i, 2);
-                
-                int value = std::stoi(byteHex, nullptr, 16);
-                bytes.push_back(value);
-            }
+    for (int i = 0; i < length; i++) 
+    {
+        int value = bytes[i];
+        if (value == groupValue) 
+        {
+            groupCount++;
+            continue;
         }
+
+        // Different value, process the previous group and start a new one
+        flushGroup();
+        groupValue = value;
+        groupCount = 1;
+        groupTimestampNs = rxTimestampNs;
+        groupArrivalNs = rxArrivalNs;
+        groupOpenedNs = 0;
+    }
+
+    // Only rotation runs can continue in the next packet, everything else goes out now
+    bool holdOpen = false;
+    if (groupValue >= 0 && server && server->decoderOptions.idleFlushMs > 0)
+    {
+        const ProfileEntry* entry = profile->Lookup(groupValue);
+        holdOpen = entry && entry->kind == EventKind::Rotation;
+        if (holdOpen && groupOpenedNs == 0) groupOpenedNs = steadyNowNs();
+        if (holdOpen && holdTimeoutMs(server->decoderOptions.idleFlushMs, server->decoderOptions.maxHoldMs) == 0) holdOpen = false;
+    }
+    if (!holdOpen) flushGroup();
+}
+
+/**
+ * Flush the Open Group
+ * Hands the current run of identical bytes to handleTourBoxInput
+ */
+void TourBoxClientWrapper::flushGroup()
+{
+    if (groupValue < 0) return;
+
+    if (DEBUG) 
+    {
+        std::cout << "Sequential group: " << groupValue << " (count: " << groupCount << ")" << std::endl;
         
-        // Process bytes sequentially, grouping consecutive identical values
-        if (!bytes.empty()) 
-		{
-            int currentValue = bytes[0];
-            int count = 1;
-            
-            for (size_t i = 1; i < bytes.size(); i++) 
-			{
-                if (bytes[i] == currentValue) 
-				{
-                    count++;
-                } 
-				else 
-				{
-                    // Different value, process the previous group
-                    if (DEBUG) 
-					{
-                        std::cout << "Sequential group: " << currentValue << " (count: " << count << ")" << std::endl;
-                        
-                        // Map to control name
-                        auto it = controlMap.find(currentValue);
-                        std::string controlName = (it != controlMap.end()) ? it->second.name : "Unknown (" + std::to_string(currentValue) + ")";
-                        std::cout << "Action: " << controlName << " x" << count << std::endl;
-                    }
-                    
-                    // Call handler with the count for this group
-                    handleTourBoxInput(currentValue, count);
-                    
-                    // Start new group
-                    currentValue = bytes[i];
-                    count = 1;
-                }
-            }
-            
-            // Process the final group
-            if (DEBUG) 
-			{
-                std::cout << "Sequential group: " << currentValue << " (count: " << count << ")" << std::endl;
-                
-                // Map to control name
-                auto it = controlMap.find(currentValue);
-                std::string controlName = (it != controlMap.end()) ? it->second.name : "Unknown (" + std::to_string(currentValue) + ")";
-                std::cout << "Action: " << controlName << " x" << count << std::endl;
-            }
-            
-            // Call handler with the count for the final group
-            handleTourBoxInput(currentValue, count);
-        }
-    } 
-	catch (const std::exception& e) 
-	{
-        if (DEBUG) std::cerr << "Parse error: " << e.what() << std::endl;
+        // Map to control name
+        const ProfileEntry* entry = profile->Lookup(groupValue);
+        std::string controlName = entry ? EventName(entry->eventId) : "Unknown (" + std::to_string(groupValue) + ")";
+        std::cout << "Action: " << controlName << " x" << groupCount << std::endl;
     }
+
+    int value = groupValue;
+    int count = groupCount;
+    eventTimestampNs = groupTimestampNs;
+    eventArrivalNs = groupArrivalNs;
+    groupValue = -1;
+    groupCount = 0;
+
+    // Call handler with the count for this group
+    handleTourBoxInput(value, count);
 }
 
 /**
@@ -253,57 +456,181 @@ void TourBoxClientWrapper::parseTourBoxData(const std::string& hexData)
  * @param value The byte value representing a specific TourBox control
  * @param count Number of times this control was triggered consecutively
  * 
- * Looks up the control in the mapping table and executes its action
+ * Looks up the control in the profile's decode table
  * Handles button state tracking for press/release pairs
  * Manages held button states to prevent duplicate press events
  * Emits appropriate events to Node.js with count information
  */
 void TourBoxClientWrapper::handleTourBoxInput(int value, int count) 
 {
-    auto it = controlMap.find(value);
-    if (it == controlMap.end()) 
+    const ProfileEntry* entry = profile->Lookup(value);
+    if (!entry) 
 	{
         if (DEBUG) std::cout << "Unhandled control (" << value << ")" << std::endl;
         return;
     }
     
-    const ControlAction& action = it->second;
+    const ProfileEntry& action = *entry;
+    bool isPress = action.kind == EventKind::Press;
+    int releasedCode = -1;
     
     // Update button state tracking (stored on server)
-    if (action.isPress) 
+    if (isPress) 
     {
         // Press event: mark the press code as held
         if (server) server->SetButtonHeld(value, true);
-        if (DEBUG) std::cout << action.name << " - HELD" << std::endl;
+        if (std::find(heldCodes.begin(), heldCodes.end(), value) == heldCodes.end()) heldCodes.push_back(value);
+        if (DEBUG) std::cout << EventName(action.eventId) << " - HELD" << std::endl;
     } 
-    else
+    else if (action.kind == EventKind::Release)
     {
-        // Release event: find the corresponding press code (press.releaseCode == this release value)
+        // Release event: the profile pairs it with its press code
         if (server) {
-            int releaseValue = value;
-            int pressCodeToClear = -1;
-            for (const auto& pair : controlMap) {
-                const int code = pair.first;
-                const ControlAction& ca = pair.second;
-                if (ca.isPress && ca.releaseCode == releaseValue) {
-                    pressCodeToClear = code;
-                    break;
-                }
-            }
+            int pressCodeToClear = action.partner;
 
             if (pressCodeToClear != -1 && server->IsButtonHeld(pressCodeToClear)) {
                 server->SetButtonHeld(pressCodeToClear, false);
-                if (DEBUG) std::cout << action.name << " - RELEASED (cleared press code " << pressCodeToClear << ")" << std::endl;
+                releasedCode = pressCodeToClear;
+                heldCodes.erase(std::remove(heldCodes.begin(), heldCodes.end(), pressCodeToClear), heldCodes.end());
+                if (DEBUG) std::cout << EventName(action.eventId) << " - RELEASED (cleared press code " << pressCodeToClear << ")" << std::endl;
             }
         }
     }
     
-    if (DEBUG) std::cout << "Custom action: " << action.name << "!" << std::endl;
-    
-    // Execute the lambda action if it exists
-    if (action.action != nullptr) 
-	{
-        action.action(count);
+    if (DEBUG) std::cout << "Control: " << EventName(action.eventId) << "!" << std::endl;
+
+    // Resolve the byte on its layer: presses on the layer active before any switch they cause,
+    // releases on the layer of their press, everything else on the active layer
+    uint16_t eventId = action.eventId;
+    if (server && server->layers.Enabled())
+    {
+        int layer = isPress ? server->layers.OnPress(value)
+                  : (releasedCode != -1 ? server->layers.OnRelease(releasedCode) : server->layers.ActiveLayer());
+        eventId = server->layers.Resolve(layer, value, action.eventId);
+    }
+
+    emitEvent(value, action, count, eventId);
+
+    // Releases are not steps, so "Up, Up" means two presses whatever happens in between
+    if (server && server->sequences.Enabled() && action.kind != EventKind::Release) matchSequences(value, eventId);
+
+    // Gestures follow the raw press / release they are derived from
+    if (server && isPress) server->gestures.OnPress(value, *eventSource, eventTimestampNs);
+    else if (server && releasedCode != -1) server->gestures.OnRelease(releasedCode, *eventSource, eventTimestampNs);
+}
+
+/**
+ * Queue a Decoded Event for Node.js
+ * @param value Protocol byte that produced the event
+ * @param action Profile entry of the byte
+ * @param count Number of consecutive repeats
+ * @param eventId Event name the byte resolved to on the active layer
+ *
+ * Only writes a fixed-size record into this connection's ring; the
+ * dispatcher thread does the (slower) hand-off to JavaScript. With
+ * acceleration enabled, rotations also carry the signed delta scaled by
+ * the axis curve at the control's current velocity.
+ */
+void TourBoxClientWrapper::emitEvent(int value, const ProfileEntry& action, int count, uint16_t eventId)
+{
+    if (!server) return;
+
+    TourBoxEvent ev = {};
+    ev.id = eventId;
+    ev.code = (uint8_t)value;
+    ev.kind = action.kind;
+    ev.axis = action.axis;
+    ev.direction = action.direction;
+    ev.count = count;
+    ev.timestampNs = eventTimestampNs;
+
+    const AccelerationOptions& accel = server->accelerationOptions;
+    if (accel.enabled && action.kind == EventKind::Rotation && action.axis < kMaxRotationAxes)
+    {
+        double speed = velocity[action.axis].Update(eventArrivalNs, action.direction, count, accel);
+        ev.hasValue = true;
+        ev.value = action.direction * count * accel.curves[action.axis].Multiplier(speed);
+        if (DEBUG) std::cout << EventName(eventId) << " velocity " << speed << " steps/s, delta " << ev.value << std::endl;
+    }
+
+    if (server->sampler.Enabled())
+    {
+        // Sampling mode: only the sampler's periodic record reaches Node.js
+        // (button state reaches it through SetButtonHeld); waiters and streams still see events
+        server->waiters.Offer(ev);
+        server->streams.Offer(ev);
+        if (action.kind == EventKind::Rotation)
+        {
+            server->sampler.AddRotation(action.axis, action.direction * count, ev.hasValue ? ev.value : (double)action.direction * count);
+        }
+    }
+    else
+    {
+        server->dispatcher.Push(*eventSource, ev);
+    }
+
+    if (action.kind == EventKind::Rotation) updateEncoders(ev);
+}
+
+/**
+ * Move the Virtual Encoders Bound to a Rotation
+ * @param rotation Rotation event just queued (its scaled delta when it has one)
+ *
+ * Values are written straight into the shared storage; an event is only
+ * queued for encoders that asked for change notification (never in
+ * sampling mode).
+ */
+void TourBoxClientWrapper::updateEncoders(const TourBoxEvent& rotation)
+{
+    EncoderBank& encoders = server->encoders;
+    double delta = rotation.hasValue ? rotation.value : (double)rotation.direction * rotation.count;
+
+    for (int index : encoders.Bound(rotation.axis))
+    {
+        double value;
+        if (!encoders.Move(index, delta, value)) continue;
+
+        const EncoderConfig& config = encoders.Config(index);
+        if (DEBUG) std::cout << "Encoder " << config.name << " = " << value << std::endl;
+        if (!config.notify || server->sampler.Enabled()) continue;
+
+        TourBoxEvent ev = {};
+        ev.id = config.eventId;
+        ev.kind = EventKind::Encoder;
+        ev.count = index;
+        ev.hasValue = true;
+        ev.value = value;
+        ev.timestampNs = rotation.timestampNs;
+        server->dispatcher.Push(*eventSource, ev);
+    }
+}
+
+/**
+ * Feed an Event to the Shortcut Automaton
+ * @param value Protocol byte of the event
+ * @param eventId Event it was queued as (after layer resolution)
+ *
+ * Completed sequences are queued right behind the event that completed them
+ */
+void TourBoxClientWrapper::matchSequences(int value, uint16_t eventId)
+{
+    int64_t now = steadyNowNs();
+
+    sequenceMatches.clear();
+    server->sequences.Advance(sequenceState, eventId, now, sequenceMatches);
+    if (server->sampler.Enabled()) return;
+
+    for (uint16_t id : sequenceMatches)
+    {
+        if (DEBUG) std::cout << "Sequence: " << EventName(id) << std::endl;
+
+        TourBoxEvent ev = {};
+        ev.id = id;
+        ev.code = (uint8_t)value;
+        ev.kind = EventKind::Gesture;
+        ev.count = 1;
+        ev.timestampNs = eventTimestampNs;
+        server->dispatcher.Push(*eventSource, ev);
     }
 }
 
@@ -322,12 +649,8 @@ bool TourBoxClientWrapper::isButtonHeld(int buttonCode)
 }
 bool TourBoxClientWrapper::isButtonHeld(const std::string& buttonName) 
 {
-    for (const auto& pair : controlMap) 
-    {
-        if (pair.second.name == buttonName) 
-        {
-            return isButtonHeld(pair.first);
-        }
-    }
-    return false;
+    // Not on the decode path, so take a reference instead of relying on this thread's RCU state
+    std::shared_ptr<const DeviceProfile> current = server ? server->profiles.Current() : DeviceProfile::Builtin();
+    int code = current->CodeOf(buttonName);
+    return code >= 0 && isButtonHeld(code);
 }
\ No newline at end of file
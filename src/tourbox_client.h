@@ -1,20 +1,11 @@
 #pragma once
 
 #include "tourbox_server.h"
-#include <map>
+#include "tourbox_events.h"
+#include "tourbox_velocity.h"
+#include "tourbox_profile.h"
 #include <string>
-#include <functional>
-
-struct ControlAction 
-{
-    std::string name;
-    bool isPress;           // true for press events, false for release events
-    int releaseCode;        // corresponding release code for press events (-1 if not applicable)
-    std::function<void(int)> action; // lambda function called with count parameter
-    
-    ControlAction(const std::string& n, bool press = false, int release = -1, std::function<void(int)> func = nullptr) 
-        : name(n), isPress(press), releaseCode(release), action(func) {}
-};
+#include <vector>
 
 class TourBoxServerWrapper; // forward declaration
 
@@ -26,8 +17,36 @@ class TourBoxClientWrapper
 		// Pointer to server to access shared state (button states live on server)
 		TourBoxServerWrapper* server;
 		
-		// Control mapping with lambdas that emit to Node.js
-		std::map<int, ControlAction> controlMap;
+		// Decode table: the server's active profile, reloaded each time the thread comes
+		// back online after blocking, so a swap applies from the next packet
+		const DeviceProfile* profile;
+		RcuReader* rcuReader;
+
+		// Receive time of the packet being decoded (ns since the Unix epoch, 0 when disabled)
+		int64_t rxTimestampNs;
+
+		// Streaming decoder state: the run of identical bytes still open (-1 = none)
+		int groupValue;
+		int groupCount;
+		int64_t groupTimestampNs;
+		int64_t groupOpenedNs;		// steady clock when the open run started, for decoderOptions.maxHoldMs
+		int64_t eventTimestampNs;	// timestamp of the group being handled
+
+		// Rotation acceleration: arrival clock (kernel timestamp, else steady clock) and per-axis estimators
+		int64_t rxArrivalNs;
+		int64_t groupArrivalNs;
+		int64_t eventArrivalNs;
+		VelocityEstimator velocity[kMaxRotationAxes];
+
+		// Position in the server's shortcut automaton, and its scratch output
+		SequenceState sequenceState;
+		std::vector<uint16_t> sequenceMatches;
+
+		// Press codes this connection has marked held, released if it disconnects
+		std::vector<int> heldCodes;
+
+		// This connection's queue into the server's dispatcher
+		std::shared_ptr<EventSource> eventSource;
 
 	public:
 	TourBoxClientWrapper(socket_t socket, TourBoxServerWrapper* server);
@@ -36,11 +55,26 @@ class TourBoxClientWrapper
 		void Run();
 		void Stop();
 
+		// Embedded mode: the owner's event loop drives a non-blocking socket instead of Run()
+		socket_t Socket() const { return clientSocket; }
+		void Begin();
+		bool Poll();
+		void Finish();
+
 	private:
-		void initializeControlMap();
+		int receive(char* buffer, int length);
+		int receiveTimestamped(char* buffer, int length);
+		void handlePacket(char* buffer, int bytesReceived);
 		void processData(char* buffer, int bytesReceived);
-		void parseTourBoxData(const std::string& hexData);
+		void parseTourBoxData(const unsigned char* bytes, int length);
+		void flushGroup();
+		int holdTimeoutMs(int idleFlushMs, int maxHoldMs) const;
+		bool waitForData(int timeoutMs);
+		void refreshProfile();
 		void handleTourBoxInput(int value, int count);
+		void emitEvent(int value, const ProfileEntry& action, int count, uint16_t eventId);
+		void updateEncoders(const TourBoxEvent& rotation);
+		void matchSequences(int value, uint16_t eventId);
 		bool isButtonHeld(int buttonCode);
 		bool isButtonHeld(const std::string& buttonName);
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The TourBox Neo / Elite controls, defined once. Everything that knows the built-in layout
+// (the built-in decode table, name lookups, getAvailableControls) is generated from these lists.
+
+// X(name, clockwise / up code, counter-clockwise / down code, clockwise event, counter-clockwise event)
+#define TOURBOX_ROTARY_CONTROLS(X) \
+	X("Knob",   196, 132, "Knob CW",   "Knob CCW") \
+	X("Scroll", 201, 137, "Scroll Up", "Scroll Down") \
+	X("Dial",   207, 143, "Dial CW",   "Dial CCW")
+
+// X(name, press code, release code) - events are "<name> Press" / "<name> Release"
+#define TOURBOX_BUTTON_CONTROLS(X) \
+	X("Knob",   55,  183) \
+	X("Dial",   56,  184) \
+	X("Scroll", 10,  138) \
+	X("Up",     16,  144) \
+	X("Down",   17,  145) \
+	X("Left",   18,  146) \
+	X("Right",  19,  147) \
+	X("Tall",   0,   128) \
+	X("Side",   1,   129) \
+	X("Top",    2,   130) \
+	X("Short",  3,   131) \
+	X("Tour",   42,  170) \
+	X("C1",     34,  162) \
+	X("C2",     35,  163)
+
+struct BuiltinRotary
+{
+	const char* name;
+	int positiveCode;
+	int negativeCode;
+	const char* positiveName;
+	const char* negativeName;
+};
+
+struct BuiltinButton
+{
+	const char* name;
+	int pressCode;
+	int releaseCode;
+};
+
+#define TOURBOX_ROTARY_ENTRY(name, cw, ccw, cwName, ccwName) BuiltinRotary{name, cw, ccw, cwName, ccwName},
+#define TOURBOX_BUTTON_ENTRY(name, press, release) BuiltinButton{name, press, release},
+
+constexpr BuiltinRotary kBuiltinRotaries[] = { TOURBOX_ROTARY_CONTROLS(TOURBOX_ROTARY_ENTRY) };
+constexpr BuiltinButton kBuiltinButtons[] = { TOURBOX_BUTTON_CONTROLS(TOURBOX_BUTTON_ENTRY) };
+
+#undef TOURBOX_ROTARY_ENTRY
+#undef TOURBOX_BUTTON_ENTRY
+
+// FNV-1a with a seed, the hash of the profiles' perfect-hash name index (DeviceProfile::Finish)
+constexpr uint32_t ControlNameHash(const char* text, size_t length, uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)text[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Marks a code as used; false if it is not a byte or was used before
+constexpr bool ClaimBuiltinCode(bool (&used)[256], int code)
+{
+	if (code < 0 || code > 255 || used[code]) return false;
+	used[code] = true;
+	return true;
+}
+
+// Every built-in code is a byte and used once, checked at compile time
+constexpr bool BuiltinCodesAreUnique()
+{
+	bool used[256] = {};
+	for (const BuiltinRotary& r : kBuiltinRotaries)
+	{
+		if (!ClaimBuiltinCode(used, r.positiveCode) || !ClaimBuiltinCode(used, r.negativeCode)) return false;
+	}
+	for (const BuiltinButton& b : kBuiltinButtons)
+	{
+		if (!ClaimBuiltinCode(used, b.pressCode) || !ClaimBuiltinCode(used, b.releaseCode)) return false;
+	}
+	return true;
+}
+
+static_assert(BuiltinCodesAreUnique(), "Built-in TourBox controls reuse a byte code");
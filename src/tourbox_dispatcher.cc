@@ -0,0 +1,562 @@
+#include "tourbox_dispatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+// Rotation records a connection may hold back before they are sent regardless of the credit
+// (only reached when the direction keeps flipping, same-direction steps merge into one record)
+const size_t kMaxPendingRotations = 256;
+
+/**
+ * Wake the Dispatcher if it is Idle
+ * Costs one atomic load when the dispatcher is already busy
+ */
+void DispatchSignal::Wake()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            sleeping = false;
+        }
+        cond.notify_one();
+    }
+}
+
+/**
+ * Batch Consumed by JavaScript
+ * Returns the rotation-lane credit so the next coalesced rotation batch can be sent
+ */
+void EventBatch::Delivered()
+{
+    if (!signal) return;
+    signal->rotationsInFlight = false;
+    signal->Wake();
+    signal.reset();
+}
+
+/**
+ * Constructor - Create an idle dispatcher
+ * The delivery thread is not started until Start() is called
+ */
+TourBoxDispatcher::TourBoxDispatcher() : running(false), inlineMode(false), aggregateWindowNs(-1), waiters(nullptr), streams(nullptr), owner(0), sourcesVersion(0), closingSources(0), signal(std::make_shared<DispatchSignal>())
+{
+}
+
+/**
+ * Destructor - Stop the delivery thread if it is still running
+ */
+TourBoxDispatcher::~TourBoxDispatcher()
+{
+    Stop();
+}
+
+/**
+ * Start the Delivery Thread
+ * @param placement CPU / scheduling placement for the dispatcher thread
+ * @param threadName Name shown in profilers
+ */
+void TourBoxDispatcher::Start(const ThreadPlacement& placement, const std::string& threadName)
+{
+    if (running) return;
+    running = true;
+    thread = std::thread([this, placement, threadName]()
+    {
+        ApplyThreadPlacement(placement, threadName);
+        Run();
+    });
+}
+
+/**
+ * Start Without a Delivery Thread
+ * Every Notify() delivers what was pushed since the previous one on the
+ * calling thread, so producers must run on the JavaScript thread
+ */
+void TourBoxDispatcher::StartInline()
+{
+    if (running) return;
+    inlineMode = true;
+    running = true;
+}
+
+/**
+ * Drop Undelivered Inline Events
+ * For a stop from inside a callback: the decoder may still push and flush
+ * before the owner tears the server down, none of which may reach JavaScript
+ */
+void TourBoxDispatcher::DiscardInline()
+{
+    for (const TourBoxEvent& ev : inlineEvents)
+    {
+        delete ev.raw;
+    }
+    inlineEvents.clear();
+}
+
+/**
+ * Configure Rotation Aggregation
+ * @param windowNs < 0 disables aggregation, 0 aggregates until JavaScript has
+ *                 consumed the previous rotation batch ("next tick"), > 0 sets
+ *                 the window length in nanoseconds
+ */
+void TourBoxDispatcher::SetAggregationWindow(int64_t windowNs)
+{
+    aggregateWindowNs = windowNs;
+}
+
+/**
+ * Stop the Delivery Thread
+ * Events already queued are delivered before the thread exits
+ */
+void TourBoxDispatcher::Stop()
+{
+    if (!running && !thread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> g(signal->mutex);
+        running = false;
+        signal->sleeping = false;
+    }
+    signal->cond.notify_one();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    for (const TourBoxEvent& ev : inlineEvents)
+    {
+        delete ev.raw;
+    }
+    inlineEvents.clear();
+
+    // Release anyone still waiting in Unregister()
+    std::lock_guard<std::mutex> g(sourcesMutex);
+    sources.clear();
+    sourcesChanged.notify_all();
+}
+
+/**
+ * Register a Producer
+ * @return Queue the calling thread pushes its events into
+ */
+std::shared_ptr<EventSource> TourBoxDispatcher::Register()
+{
+    auto source = std::make_shared<EventSource>();
+    std::lock_guard<std::mutex> g(sourcesMutex);
+    sources.push_back(source);
+    sourcesVersion++;
+    return source;
+}
+
+/**
+ * Unregister a Producer
+ * @param source Queue returned by Register()
+ *
+ * Blocks until everything the producer pushed has been handed to Node.js,
+ * so events that follow (such as "disconnect") cannot overtake them.
+ */
+void TourBoxDispatcher::Unregister(const std::shared_ptr<EventSource>& source)
+{
+    if (!source) return;
+
+    // Inline, everything pushed is delivered by the Notify() itself
+    if (inlineMode)
+    {
+        Notify();
+        std::lock_guard<std::mutex> g(sourcesMutex);
+        sources.erase(std::remove(sources.begin(), sources.end(), source), sources.end());
+        sourcesVersion++;
+        return;
+    }
+
+    source->closing = true;
+    closingSources++;
+    Notify();
+
+    std::unique_lock<std::mutex> lock(sourcesMutex);
+    sourcesChanged.wait(lock, [this, &source]()
+    {
+        return std::find(sources.begin(), sources.end(), source) == sources.end();
+    });
+}
+
+/**
+ * Queue an Event
+ * @param source The calling thread's queue
+ * @param ev Event record; ownership of ev.raw passes to the dispatcher
+ *
+ * Does not wake the dispatcher; call Notify() once the packet is decoded.
+ * When the ring is full the producer waits for the dispatcher to catch up
+ * rather than dropping input. Pending waiters and open streams see every
+ * event first. Events
+ * without a JavaScript listener are then dropped here, except rotations
+ * while aggregating: both directions feed the net total, so those are
+ * filtered once it is named in takeRotations().
+ */
+void TourBoxDispatcher::Push(EventSource& source, const TourBoxEvent& ev)
+{
+    if (ev.kind != EventKind::Raw)
+    {
+        if (waiters) waiters->Offer(ev);
+        if (streams) streams->Offer(ev);
+    }
+
+    bool netted = ev.kind == EventKind::Rotation && aggregateWindowNs.load(std::memory_order_relaxed) >= 0;
+    if (ev.kind != EventKind::Raw && !netted && !filter.Wants(ev.id)) return;
+
+    if (inlineMode)
+    {
+        inlineEvents.push_back(ev);
+        return;
+    }
+
+    while (!source.ring.Push(ev))
+    {
+        if (!running)
+        {
+            delete ev.raw;
+            return;
+        }
+        Notify();
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * Wake the Dispatcher if it is Idle
+ * Inline, deliver the pushed events now instead
+ */
+void TourBoxDispatcher::Notify()
+{
+    if (!inlineMode)
+    {
+        signal->Wake();
+        return;
+    }
+    if (inlineEvents.empty()) return;
+
+    // Swapped out first: a callback may stop the server, which clears inlineEvents
+    std::vector<TourBoxEvent> events;
+    events.swap(inlineEvents);
+    DeliverEventsInline(owner, events);
+}
+
+/**
+ * Main Dispatcher Loop
+ * Drains all sources, sends button transitions straight away and coalesced
+ * rotations whenever the credit is free, then sleeps until a producer or a
+ * completed rotation batch wakes it
+ */
+void TourBoxDispatcher::Run()
+{
+    std::vector<std::shared_ptr<EventSource>> snapshot;
+    unsigned snapshotVersion = ~0u;
+
+    while (true)
+    {
+        if (snapshotVersion != sourcesVersion.load())
+        {
+            std::lock_guard<std::mutex> g(sourcesMutex);
+            snapshot = sources;
+            snapshotVersion = sourcesVersion.load();
+        }
+
+        // Transition lane: never waits for the credit
+        auto* batch = new EventBatch();
+        batch->owner = owner;
+        for (const auto& source : snapshot)
+        {
+            drain(*source, batch->events);
+        }
+
+        if (!batch->events.empty())
+        {
+            DeliverEvents(batch);
+        }
+        else
+        {
+            delete batch;
+        }
+
+        // Rotation lane: one batch in flight at a time (everything goes out on shutdown)
+        int64_t nextDeadlineNs = 0;
+        bool rotationsPending = flushRotations(snapshot, !running, nextDeadlineNs);
+
+        if (closingSources.load() > 0 && retireClosedSources())
+        {
+            continue;
+        }
+
+        if (!running)
+        {
+            break;
+        }
+
+        // Go idle, re-checking the rings after announcing it so no push is missed
+        std::unique_lock<std::mutex> lock(signal->mutex);
+        signal->sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool pending = rotationsPending && !signal->rotationsInFlight.load();
+        for (const auto& source : snapshot)
+        {
+            if (!source->ring.Empty()) pending = true;
+        }
+        if (pending || snapshotVersion != sourcesVersion.load())
+        {
+            signal->sleeping = false;
+            continue;
+        }
+
+        // Sleep until woken, or until the earliest aggregation window closes
+        int64_t sleepNs = 100000000;
+        if (nextDeadlineNs)
+        {
+            sleepNs = std::max<int64_t>(0, std::min<int64_t>(sleepNs, nextDeadlineNs - steadyNowNs()));
+        }
+        signal->cond.wait_for(lock, std::chrono::nanoseconds(sleepNs), [this]() { return !signal->sleeping || !running; });
+        signal->sleeping = false;
+    }
+}
+
+/**
+ * Drain One Source
+ * @param source Source to read from
+ * @param transitions Receives button transitions and raw packets, in order
+ *
+ * Rotations go to the source's rotation lane. Rotations still waiting when a
+ * transition arrives are sent in front of it: they are already coalesced,
+ * and keeping them first preserves what was held while the control turned
+ * (this also closes an aggregation window early).
+ */
+void TourBoxDispatcher::drain(EventSource& source, std::vector<TourBoxEvent>& transitions)
+{
+    TourBoxEvent ev;
+    while (source.ring.Pop(ev))
+    {
+        if (ev.kind == EventKind::Rotation || ev.kind == EventKind::Encoder)
+        {
+            queueRotation(source, ev);
+            continue;
+        }
+
+        if (ev.kind != EventKind::Raw && !source.rotations.empty())
+        {
+            takeRotations(source, transitions);
+        }
+        transitions.push_back(ev);
+    }
+}
+
+/**
+ * Add a Rotation to a Source's Lane
+ * @param source Lane owner
+ * @param ev Rotation event
+ *
+ * Without aggregation, merges into the previous record when it is the same
+ * control. With aggregation, keeps one signed running total per axis; the
+ * total is marked by direction 0 until it is taken. A step whose event name
+ * differs from the total's (layer switch, profile swap) settles the total
+ * under its own names and starts a new one. Records that already
+ * carry a scaled delta (acceleration) add that delta instead of the steps.
+ * Encoder notifications replace the pending one for the same encoder.
+ */
+void TourBoxDispatcher::queueRotation(EventSource& source, const TourBoxEvent& ev)
+{
+    if (ev.kind == EventKind::Encoder)
+    {
+        if (source.rotations.empty()) source.windowStartNs = steadyNowNs();
+        for (TourBoxEvent& pending : source.rotations)
+        {
+            if (pending.kind == EventKind::Encoder && pending.id == ev.id)
+            {
+                pending = ev;
+                return;
+            }
+        }
+        source.rotations.push_back(ev);
+        return;
+    }
+
+    bool aggregate = aggregateWindowNs.load(std::memory_order_relaxed) >= 0 && ev.axis != AxisNone && ev.axis < kMaxRotationAxes;
+    if (source.rotations.empty()) source.windowStartNs = steadyNowNs();
+
+    if (!aggregate)
+    {
+        const TourBoxEvent* back = source.rotations.empty() ? nullptr : &source.rotations.back();
+        if (back && back->kind == EventKind::Rotation && back->id == ev.id && back->direction != 0)
+        {
+            source.rotations.back().count += ev.count;
+            source.rotations.back().value += ev.value;
+        }
+        else
+        {
+            source.rotations.push_back(ev);
+        }
+        return;
+    }
+
+    // Remember which event name each direction uses, to name the net result later
+    uint16_t* ids = source.netEventIds[ev.axis];
+    int side = ev.direction > 0 ? 1 : 0;
+
+    int32_t steps = ev.direction * ev.count;
+    double delta = ev.hasValue ? ev.value : (double)steps;
+    for (auto pending = source.rotations.begin(); pending != source.rotations.end(); ++pending)
+    {
+        if (pending->kind != EventKind::Rotation || pending->direction != 0 || pending->axis != ev.axis) continue;
+
+        if (ids[side] == kInvalidEventId || ids[side] == ev.id)
+        {
+            ids[side] = ev.id;
+            pending->count += steps;
+            pending->value += delta;
+            return;
+        }
+
+        // Renamed mid-window: what was netted so far keeps the names it was produced under
+        if (!settleNet(source, *pending)) source.rotations.erase(pending);
+        break;
+    }
+
+    ids[0] = ids[1] = kInvalidEventId;
+    ids[side] = ev.id;
+
+    TourBoxEvent net = ev;
+    net.direction = 0;
+    net.hasValue = true;
+    net.count = steps;
+    net.value = delta;
+    source.rotations.push_back(net);
+}
+
+/**
+ * Name an Aggregated Total
+ * @param source Lane owner, holding the event ids the total was netted from
+ * @param ev Running total (direction 0); becomes the event named after the
+ *           sign of the net delta, with |net steps| as count and the signed
+ *           net delta as value
+ * @return false if the total cancels out or nobody listens to the result
+ */
+bool TourBoxDispatcher::settleNet(const EventSource& source, TourBoxEvent& ev) const
+{
+    if (ev.value == 0 && ev.count == 0) return false;
+    double sign = ev.value != 0 ? ev.value : (double)ev.count;
+    ev.direction = sign > 0 ? 1 : -1;
+    ev.id = source.netEventIds[ev.axis][ev.direction > 0 ? 1 : 0];
+    ev.count = ev.count < 0 ? -ev.count : ev.count;
+    return ev.id != kInvalidEventId && filter.Wants(ev.id);
+}
+
+/**
+ * Move a Source's Rotation Lane Into a Batch
+ * @param source Lane owner
+ * @param out Receives the rotations; aggregated totals become a single event
+ *            named after the sign of the net delta, with |net steps| as count
+ *            and the signed net delta (totals that cancel out are dropped)
+ */
+void TourBoxDispatcher::takeRotations(EventSource& source, std::vector<TourBoxEvent>& out)
+{
+    for (TourBoxEvent ev : source.rotations)
+    {
+        if (ev.kind == EventKind::Rotation && ev.direction == 0 && !settleNet(source, ev)) continue;
+        out.push_back(ev);
+    }
+    source.rotations.clear();
+    source.windowStartNs = 0;
+}
+
+/**
+ * Send the Rotation Lane
+ * @param snapshot Sources whose lanes are sent
+ * @param force Ignore the credit and open windows (shutdown)
+ * @param nextDeadlineNs Receives the steady-clock time the next window closes (0 = none)
+ * @return true if rotations are ready but waiting for the credit
+ *
+ * A closing source is sent like on shutdown: its producer blocks in
+ * Unregister() until the lane is empty, and that producer may be the
+ * JavaScript thread, which is the only one that returns the credit.
+ */
+bool TourBoxDispatcher::flushRotations(const std::vector<std::shared_ptr<EventSource>>& snapshot, bool force, int64_t& nextDeadlineNs)
+{
+    int64_t window = aggregateWindowNs.load(std::memory_order_relaxed);
+    int64_t now = window > 0 ? steadyNowNs() : 0;
+
+    std::vector<EventSource*> ready;
+    bool overflow = false;
+    bool closing = false;
+    for (const auto& source : snapshot)
+    {
+        if (source->rotations.empty()) continue;
+
+        bool sourceClosing = source->closing.load();
+        if (window > 0 && !force && !sourceClosing && now - source->windowStartNs < window)
+        {
+            int64_t deadline = source->windowStartNs + window;
+            if (!nextDeadlineNs || deadline < nextDeadlineNs) nextDeadlineNs = deadline;
+            continue;
+        }
+
+        ready.push_back(source.get());
+        if (source->rotations.size() >= kMaxPendingRotations) overflow = true;
+        if (sourceClosing) closing = true;
+    }
+    if (ready.empty()) return false;
+
+    bool expected = false;
+    bool haveCredit = signal->rotationsInFlight.compare_exchange_strong(expected, true);
+    if (!haveCredit && !force && !overflow && !closing) return true;
+
+    auto* batch = new EventBatch();
+    batch->owner = owner;
+    for (EventSource* source : ready)
+    {
+        takeRotations(*source, batch->events);
+    }
+
+    if (DEBUG) std::cout << "Rotation batch: " << batch->events.size() << " record(s)" << std::endl;
+
+    if (batch->events.empty())
+    {
+        // Everything cancelled out
+        if (haveCredit) signal->rotationsInFlight = false;
+        delete batch;
+        return false;
+    }
+
+    // Only the batch that took the credit gives it back
+    if (haveCredit) batch->signal = signal;
+    DeliverEvents(batch);
+    return false;
+}
+
+/**
+ * Remove Sources Whose Producer Has Unregistered
+ * Only sources whose ring and rotation lane are both empty, i.e. whose last
+ * events were already handed to Node.js
+ * @return true if any source was removed
+ */
+bool TourBoxDispatcher::retireClosedSources()
+{
+    std::lock_guard<std::mutex> g(sourcesMutex);
+    auto it = std::remove_if(sources.begin(), sources.end(), [this](const std::shared_ptr<EventSource>& source)
+    {
+        if (source->closing.load() && source->ring.Empty() && source->rotations.empty())
+        {
+            closingSources--;
+            return true;
+        }
+        return false;
+    });
+
+    if (it == sources.end()) return false;
+
+    sources.erase(it, sources.end());
+    sourcesVersion++;
+    sourcesChanged.notify_all();
+    return true;
+}
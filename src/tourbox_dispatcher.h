@@ -0,0 +1,196 @@
+#pragma once
+
+#include "tourbox_events.h"
+#include "tourbox_streams.h"
+#include "tourbox_thread.h"
+#include "tourbox_waiters.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Wake-up state shared with batches in flight, so a completion can safely outlive the dispatcher
+struct DispatchSignal
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::atomic<bool> sleeping{false};
+	std::atomic<bool> rotationsInFlight{false};
+
+	void Wake();
+};
+
+// A batch of events handed to Node.js in one thread-safe call
+struct EventBatch
+{
+	std::vector<TourBoxEvent> events;
+	std::shared_ptr<DispatchSignal> signal;	// set on rotation-lane batches, which hold the delivery credit
+	int owner = 0;							// server it came from (TourBoxDispatcher::SetOwner)
+
+	// Called once JavaScript has run the batch (or it was dropped); returns the credit
+	void Delivered();
+};
+
+// Hand a batch of decoded events to Node.js, taking ownership (defined in tourbox_addon.cc)
+extern void DeliverEvents(EventBatch* batch);
+
+// Inline mode: call the JavaScript callbacks for these events right away, on the (JavaScript)
+// thread that decoded them; takes ownership of the raw packets (defined in tourbox_addon.cc)
+extern void DeliverEventsInline(int owner, std::vector<TourBoxEvent>& events);
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread
+template <typename T, size_t Capacity>
+class SpscRing
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+	public:
+		SpscRing() : head(0), cachedTail(0), tail(0), cachedHead(0) {}
+
+		// Producer: returns false when the ring is full
+		bool Push(const T& item)
+		{
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t - cachedHead == Capacity)
+			{
+				cachedHead = head.load(std::memory_order_acquire);
+				if (t - cachedHead == Capacity) return false;
+			}
+			slots[t & (Capacity - 1)] = item;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer: returns false when the ring is empty
+		bool Pop(T& item)
+		{
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h == cachedTail)
+			{
+				cachedTail = tail.load(std::memory_order_acquire);
+				if (h == cachedTail) return false;
+			}
+			item = slots[h & (Capacity - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool Empty() const
+		{
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+
+	private:
+		// Consumer and producer indexes live on separate cache lines
+		alignas(64) std::atomic<size_t> head;
+		size_t cachedTail;
+		alignas(64) std::atomic<size_t> tail;
+		size_t cachedHead;
+		alignas(64) T slots[Capacity];
+};
+
+// One producer's queue into the dispatcher (one per client connection)
+struct EventSource
+{
+	SpscRing<TourBoxEvent, 1024> ring;
+	std::atomic<bool> closing{false};
+
+	// Rotation lane, owned by the dispatcher thread: coalesced rotations waiting for the delivery credit
+	std::vector<TourBoxEvent> rotations;
+	int64_t windowStartNs = 0;		// steady-clock start of the current aggregation window
+
+	// Event id per axis for [negative, positive] steps of the pending aggregated total, so the net
+	// result is named after what this source produced (kInvalidEventId until a step is seen)
+	uint16_t netEventIds[kMaxRotationAxes][2];
+
+	EventSource()
+	{
+		for (auto& ids : netEventIds) ids[0] = ids[1] = kInvalidEventId;
+	}
+};
+
+// Drains every EventSource on one thread and delivers batches to Node.js,
+// so decode threads never wait on the thread-safe function queue.
+//
+// Two lanes: button transitions are delivered as soon as they are drained,
+// while rotations are coalesced and only sent when JavaScript has consumed
+// the previous rotation batch. A scroll flood therefore occupies at most one
+// batch in the queue ahead of a release, instead of hundreds of entries.
+//
+// With aggregation enabled, rotations are netted per axis (Knob / Dial /
+// Scroll) across packets and released once per window, carrying the signed
+// net delta, so the event rate no longer depends on TCP segmentation.
+class TourBoxDispatcher
+{
+	public:
+		TourBoxDispatcher();
+		~TourBoxDispatcher();
+
+		void Start(const ThreadPlacement& placement, const std::string& threadName);
+		void Stop();
+
+		// No delivery thread: producers on the JavaScript thread have Notify() hand their
+		// events straight to DeliverEventsInline (no rings, lanes or aggregation)
+		void StartInline();
+
+		// Inline mode: drop what was pushed but not delivered yet (the owner is stopping)
+		void DiscardInline();
+
+		// Rotation aggregation window: < 0 off, 0 until JavaScript consumed the last batch, > 0 window length
+		void SetAggregationWindow(int64_t windowNs);
+		bool Aggregating() const { return aggregateWindowNs.load(std::memory_order_relaxed) >= 0; }
+
+		// Events JavaScript listens to; Push drops the rest
+		EventFilter& Filter() { return filter; }
+
+		// Pending waitFor() requests, offered every pushed event before filtering (set before Start)
+		void SetWaiters(WaiterRegistry* registry) { waiters = registry; }
+
+		// Pull-driven event streams, offered every pushed event before filtering (set before Start)
+		void SetStreams(EventStreams* registry) { streams = registry; }
+
+		// Server id stamped on delivered batches, so Node.js can tell servers apart (set before Start)
+		void SetOwner(int id) { owner = id; }
+		int Owner() const { return owner; }
+
+		// Producer API, each source must only be used from one thread
+		std::shared_ptr<EventSource> Register();
+		void Unregister(const std::shared_ptr<EventSource>& source);
+		void Push(EventSource& source, const TourBoxEvent& ev);
+		void Notify();
+
+	private:
+		void Run();
+		void drain(EventSource& source, std::vector<TourBoxEvent>& transitions);
+		void queueRotation(EventSource& source, const TourBoxEvent& ev);
+		void takeRotations(EventSource& source, std::vector<TourBoxEvent>& out);
+		bool settleNet(const EventSource& source, TourBoxEvent& ev) const;
+		bool flushRotations(const std::vector<std::shared_ptr<EventSource>>& snapshot, bool force, int64_t& nextDeadlineNs);
+		bool retireClosedSources();
+
+		std::atomic<bool> running;
+		std::thread thread;
+
+		// Inline mode: events pushed since the last Notify()
+		bool inlineMode;
+		std::vector<TourBoxEvent> inlineEvents;
+
+		std::atomic<int64_t> aggregateWindowNs;
+		EventFilter filter;
+		WaiterRegistry* waiters;
+		EventStreams* streams;
+		int owner;
+
+		// Registered sources; the dispatcher works from a snapshot refreshed on change
+		std::vector<std::shared_ptr<EventSource>> sources;
+		std::atomic<unsigned> sourcesVersion;
+		std::atomic<int> closingSources;
+		std::mutex sourcesMutex;
+		std::condition_variable sourcesChanged;
+
+		// Sleep / wake handshake, producers only signal when the dispatcher is idle
+		std::shared_ptr<DispatchSignal> signal;
+};
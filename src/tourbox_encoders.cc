@@ -0,0 +1,88 @@
+#include "tourbox_encoders.h"
+#include <cmath>
+#include <utility>
+
+/**
+ * Constructor - Zeroed Storage
+ */
+EncoderBank::EncoderBank() : values(std::make_shared<EncoderValues>())
+{
+    for (auto& v : values->values) v.store(0.0, std::memory_order_relaxed);
+}
+
+/**
+ * Define an Encoder
+ * @param config Range, step, mode and bound axis
+ * @return Index into the shared values, or -1 if kMaxEncoders are defined or no event id is left for the name
+ */
+int EncoderBank::Add(EncoderConfig config)
+{
+    if (configs.size() >= (size_t)kMaxEncoders) return -1;
+    config.eventId = InternEventName(config.name);
+    if (config.eventId == kInvalidEventId) return -1;
+    if (config.max < config.min) std::swap(config.min, config.max);
+
+    int index = (int)configs.size();
+    values->values[index].store(limit(config, config.value), std::memory_order_relaxed);
+    byAxis[config.axis < kMaxRotationAxes ? config.axis : (uint8_t)AxisNone].push_back(index);
+    configs.push_back(config);
+    return index;
+}
+
+/**
+ * Keep a Value in an Encoder's Range
+ * @param config Encoder
+ * @param value Unlimited value
+ * @return Clamped value, or wrapped into [min, max) for wrapping encoders
+ */
+double EncoderBank::limit(const EncoderConfig& config, double value) const
+{
+    double span = config.max - config.min;
+    if (config.wrap && span > 0)
+    {
+        double offset = std::fmod(value - config.min, span);
+        if (offset < 0) offset += span;
+        return config.min + offset;
+    }
+    return value < config.min ? config.min : (value > config.max ? config.max : value);
+}
+
+/**
+ * Move an Encoder
+ * @param index Encoder index
+ * @param delta Signed rotation steps (or scaled delta)
+ * @param value Receives the new value
+ * @return true if the value changed
+ *
+ * Several connections may drive the same encoder, so the update is a
+ * compare-and-swap loop rather than a load / store pair.
+ */
+bool EncoderBank::Move(int index, double delta, double& value)
+{
+    const EncoderConfig& config = configs[index];
+    std::atomic<double>& slot = values->values[index];
+
+    double current = slot.load(std::memory_order_relaxed);
+    double next;
+    do
+    {
+        next = limit(config, current + delta * config.step);
+        if (next == current) return false;
+    } while (!slot.compare_exchange_weak(current, next, std::memory_order_release, std::memory_order_relaxed));
+
+    value = next;
+    return true;
+}
+
+/**
+ * Set an Encoder
+ * @param index Encoder index
+ * @param value New value, limited to the encoder's range
+ * @return false if the index is out of range
+ */
+bool EncoderBank::Set(int index, double value)
+{
+    if (index < 0 || index >= (int)configs.size()) return false;
+    values->values[index].store(limit(configs[index], value), std::memory_order_release);
+    return true;
+}
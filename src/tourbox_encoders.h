@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tourbox_events.h"
+
+// One virtual absolute encoder driven by a rotation control
+struct EncoderConfig
+{
+	std::string name;
+	uint8_t axis = AxisNone;	// RotationAxis it follows
+	double min = 0;
+	double max = 100;
+	double step = 1;			// change per rotation step (or per unit of scaled delta)
+	double value = 0;			// initial value
+	bool wrap = false;			// wrap around at the ends instead of clamping
+	bool notify = false;		// deliver an event named after the encoder when it changes
+	uint16_t eventId = 0;
+};
+
+// Values shared with JavaScript. Read there as a Float64Array, so an atomic
+// double must be exactly a double and never take a lock.
+static_assert(sizeof(std::atomic<double>) == sizeof(double), "std::atomic<double> must have the layout of double");
+static_assert(std::atomic<double>::is_always_lock_free, "std::atomic<double> must be lock-free");
+
+const int kMaxEncoders = 64;
+
+struct EncoderValues
+{
+	std::atomic<double> values[kMaxEncoders];
+};
+
+class EncoderBank
+{
+	public:
+		EncoderBank();
+
+		// Define an encoder (before StartServer); returns its index or -1 when full or its name gets no event id
+		int Add(EncoderConfig config);
+
+		size_t Count() const { return configs.size(); }
+		const EncoderConfig& Config(int index) const { return configs[index]; }
+
+		// Encoders following an axis
+		const std::vector<int>& Bound(uint8_t axis) const { return byAxis[axis < kMaxRotationAxes ? axis : (uint8_t)AxisNone]; }
+
+		// Move an encoder by delta steps; returns true (and the new value) if it changed
+		bool Move(int index, double delta, double& value);
+
+		// Set an encoder directly, limited to its range
+		bool Set(int index, double value);
+
+		// Storage for the JavaScript view; stays valid while the pointer is held
+		std::shared_ptr<EncoderValues> Values() const { return values; }
+
+	private:
+		double limit(const EncoderConfig& config, double value) const;
+
+		std::vector<EncoderConfig> configs;
+		std::vector<int> byAxis[kMaxRotationAxes];
+		std::shared_ptr<EncoderValues> values;
+};
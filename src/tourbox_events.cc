@@ -0,0 +1,100 @@
+#include "tourbox_events.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+// Names are written once before the count is published, so readers never lock
+static std::string g_eventNames[kMaxEventIds];
+static std::atomic<uint16_t> g_eventNameCount(0);
+static std::unordered_map<std::string, uint16_t> g_eventIds;
+static std::mutex g_eventIdsMutex;
+
+/**
+ * Intern an Event Name
+ * @param name Event name as delivered to JavaScript (e.g. "Knob CW")
+ * @return Stable id for the name; the same name always yields the same id.
+ *         kInvalidEventId once kMaxEventIds names exist
+ *
+ * Ids index fixed-size tables along the event pipeline. A new name that no
+ * longer fits gets no id at all rather than sharing one with a real name, and
+ * whatever defines it must be rejected.
+ */
+uint16_t InternEventName(const std::string& name)
+{
+    std::lock_guard<std::mutex> g(g_eventIdsMutex);
+    auto it = g_eventIds.find(name);
+    if (it != g_eventIds.end()) return it->second;
+
+    uint16_t id = g_eventNameCount.load(std::memory_order_relaxed);
+    if (id >= kMaxEventIds) return kInvalidEventId;
+
+    g_eventNames[id] = name;
+    g_eventIds[name] = id;
+    g_eventNameCount.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+/**
+ * Find the Id of an Event Name
+ * @param name Event name
+ * @param id Receives the id when found
+ * @return false if the name was never interned
+ *
+ * For names that come from JavaScript at runtime: looking them up instead of
+ * interning keeps arbitrary or mistyped names from using up the id table.
+ */
+bool FindEventName(const std::string& name, uint16_t& id)
+{
+    std::lock_guard<std::mutex> g(g_eventIdsMutex);
+    auto it = g_eventIds.find(name);
+    if (it == g_eventIds.end()) return false;
+    id = it->second;
+    return true;
+}
+
+/**
+ * Look Up an Event Name
+ * @param id Id returned by InternEventName
+ * @return The interned name, or an empty string for unknown ids
+ */
+const std::string& EventName(uint16_t id)
+{
+    static const std::string empty;
+    if (id >= g_eventNameCount.load(std::memory_order_acquire)) return empty;
+    return g_eventNames[id];
+}
+
+/**
+ * Constructor - Everything Passes
+ * Until JavaScript says what it listens to, nothing is filtered
+ */
+EventFilter::EventFilter() : all(true)
+{
+    for (auto& word : words) word.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Pass Every Event
+ */
+void EventFilter::SetAll()
+{
+    all.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Pass Only the Given Events
+ * @param ids Interned ids of the names JavaScript listens to
+ *
+ * Each word is replaced whole, so an id wanted before and after the update
+ * is never dropped while it is in progress.
+ */
+void EventFilter::Set(const std::vector<uint16_t>& ids)
+{
+    uint64_t bits[kMaxEventIds / 64] = {};
+    for (uint16_t id : ids)
+    {
+        if (id < kMaxEventIds) bits[id >> 6] |= 1ULL << (id & 63);
+    }
+    for (int i = 0; i < kMaxEventIds / 64; i++) words[i].store(bits[i], std::memory_order_relaxed);
+    all.store(false, std::memory_order_relaxed);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <vector>
+
+// What a decoded event represents, used by the pipeline to decide how it may be batched
+enum class EventKind : uint8_t
+{
+	Press,			// button went down
+	Release,		// button went up
+	Rotation,		// knob / dial / scroll step(s), may be coalesced
+	Encoder,		// virtual encoder changed, only the latest value is kept
+	Gesture,		// synthesized from press / release timing (tap, long press, ...)
+	Raw				// raw packet bytes for the raw callback
+};
+
+// Rotation axes; the positive direction is clockwise / up
+const int kMaxRotationAxes = 8;
+enum RotationAxis : uint8_t
+{
+	AxisNone = 0,
+	AxisKnob = 1,
+	AxisScroll = 2,
+	AxisDial = 3
+};
+
+// Fixed-size record handed from the decode threads to the dispatcher
+struct TourBoxEvent
+{
+	uint16_t id;					// interned event name, see EventName()
+	uint8_t code;					// protocol byte that produced the event
+	EventKind kind;
+	uint8_t axis;					// RotationAxis for rotations, otherwise AxisNone
+	int8_t direction;				// +1 / -1 for rotations
+	bool hasValue;					// value is delivered to JavaScript as the event's delta
+	int32_t count;					// consecutive repeats (rotation steps)
+	int64_t timestampNs;			// receive time, ns since the Unix epoch (0 = not recorded)
+	double value;					// signed delta (see hasValue)
+	std::vector<uint8_t>* raw;		// owned packet copy for EventKind::Raw, otherwise null
+};
+
+// Upper bound on distinct event names
+const int kMaxEventIds = 1024;
+
+// Returned by InternEventName once every id is taken; never carried by an event
+const uint16_t kInvalidEventId = 0xFFFF;
+
+// Map an event name to a small stable id (thread-safe, ids are never reused), kInvalidEventId when full
+uint16_t InternEventName(const std::string& name);
+
+// Id of an already interned name; false (nothing allocated) for names no event can carry
+bool FindEventName(const std::string& name, uint16_t& id);
+
+// Name for an id returned by InternEventName (lock-free)
+const std::string& EventName(uint16_t id);
+
+// Event ids JavaScript has listeners for. Producers test it before queueing, so events
+// nobody listens to never reach the thread-safe function. Starts with everything wanted.
+class EventFilter
+{
+	public:
+		EventFilter();
+
+		bool Wants(uint16_t id) const
+		{
+			return all.load(std::memory_order_relaxed) ||
+			       (id < kMaxEventIds && ((words[id >> 6].load(std::memory_order_relaxed) >> (id & 63)) & 1));
+		}
+
+		// Deliver everything (a '*' listener) / only these ids
+		void SetAll();
+		void Set(const std::vector<uint16_t>& ids);
+
+	private:
+		std::atomic<bool> all;
+		std::atomic<uint64_t> words[kMaxEventIds / 64];
+};
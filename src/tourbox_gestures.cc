@@ -0,0 +1,227 @@
+#include "tourbox_gestures.h"
+#include <chrono>
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+/**
+ * Constructor
+ * @param timerWheel Shared timer thread used for long-press and tap timeouts
+ * @param eventDispatcher Dispatcher the gesture events are queued on
+ */
+GestureEngine::GestureEngine(TimerWheel& timerWheel, TourBoxDispatcher& eventDispatcher)
+    : timers(timerWheel), dispatcher(eventDispatcher), anyEnabled(false), running(false), timestamps(false)
+{
+}
+
+/**
+ * Configure a Button
+ * @param code Press code
+ * @param button Name used for the events, e.g. "C1" gives "C1 LongPress"
+ * @param settings Thresholds
+ * @return false if no event id was left for one of the gesture names
+ */
+bool GestureEngine::Configure(int code, const std::string& button, const GestureSettings& settings)
+{
+    if (code < 0 || code > 255) return true;
+
+    Button& b = buttons[code];
+    b.settings = settings;
+    b.tapId = InternEventName(button + " Tap");
+    b.doubleTapId = InternEventName(button + " DoubleTap");
+    b.longPressId = InternEventName(button + " LongPress");
+    if (b.tapId == kInvalidEventId || b.doubleTapId == kInvalidEventId || b.longPressId == kInvalidEventId)
+    {
+        b.settings.enabled = false;
+        return false;
+    }
+    if (settings.enabled) anyEnabled = true;
+    return true;
+}
+
+/**
+ * Start Producing Events
+ * @param stampEvents Give timer-decided events a receive-style timestamp (timestamps option)
+ */
+void GestureEngine::Start(bool stampEvents)
+{
+    if (!anyEnabled || running) return;
+    timestamps = stampEvents;
+    timerSource = dispatcher.Register();
+    running = true;
+}
+
+/**
+ * Stop Producing Events
+ * The timer wheel must already be stopped, so nothing pushes into the source anymore
+ */
+void GestureEngine::Stop()
+{
+    if (!running) return;
+    running = false;
+    dispatcher.Unregister(timerSource);
+    timerSource.reset();
+
+    std::lock_guard<std::mutex> g(mutex);
+    for (Button& b : buttons)
+    {
+        b.held = b.tapPending = b.longFired = b.consumed = false;
+        b.generation++;
+    }
+}
+
+/**
+ * Button Went Down
+ * @param code Press code
+ * @param source Calling connection's queue (for events decided right here)
+ * @param timestampNs Receive timestamp of the press
+ *
+ * A press shortly after a tap completes a double tap; otherwise it arms the
+ * long-press timer
+ */
+void GestureEngine::OnPress(int code, EventSource& source, int64_t timestampNs)
+{
+    if (!running || code < 0 || code > 255 || !buttons[code].settings.enabled) return;
+
+    bool doubleTap = false;
+    uint64_t generation;
+    int longPressMs;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        Button& b = buttons[code];
+        b.held = true;
+        b.longFired = false;
+        b.consumed = false;
+        b.pressNs = steadyNowNs();
+        generation = ++b.generation;
+        longPressMs = b.settings.longPressMs;
+
+        if (b.tapPending)
+        {
+            b.tapPending = false;
+            timers.Cancel(b.tapTimer);
+            b.consumed = true;
+            doubleTap = true;
+        }
+    }
+
+    if (doubleTap)
+    {
+        if (DEBUG) std::cout << "Gesture: " << EventName(buttons[code].doubleTapId) << std::endl;
+        push(source, buttons[code].doubleTapId, code, timestampNs);
+        return;
+    }
+
+    if (longPressMs > 0)
+    {
+        timers.Schedule(longPressMs, [this, code, generation]() { onLongPress(code, generation); });
+    }
+}
+
+/**
+ * Button Went Up
+ * @param code Press code
+ * @param source Calling connection's queue
+ * @param timestampNs Receive timestamp of the release
+ *
+ * A short press is a tap: reported now when double tap is off for the
+ * button, otherwise once the double-tap gap has passed without a second press
+ */
+void GestureEngine::OnRelease(int code, EventSource& source, int64_t timestampNs)
+{
+    if (!running || code < 0 || code > 255 || !buttons[code].settings.enabled) return;
+
+    bool tapNow = false;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        Button& b = buttons[code];
+        if (!b.held) return;
+
+        b.held = false;
+        uint64_t generation = ++b.generation;
+        int64_t heldMs = (steadyNowNs() - b.pressNs) / 1000000;
+        if (b.consumed || b.longFired || (b.settings.tapMs > 0 && heldMs > b.settings.tapMs)) return;
+
+        if (b.settings.doubleTapMs > 0)
+        {
+            b.tapPending = true;
+            b.tapTimer = timers.Schedule(b.settings.doubleTapMs, [this, code, generation]() { onTapTimeout(code, generation); });
+        }
+        else
+        {
+            tapNow = true;
+        }
+    }
+
+    if (tapNow) push(source, buttons[code].tapId, code, timestampNs);
+}
+
+/**
+ * Forget a Button
+ * @param code Press code
+ * Pending long-press and tap timers become stale and report nothing
+ */
+void GestureEngine::Cancel(int code)
+{
+    if (!running || code < 0 || code > 255 || !buttons[code].settings.enabled) return;
+
+    std::lock_guard<std::mutex> g(mutex);
+    Button& b = buttons[code];
+    b.held = b.tapPending = b.longFired = b.consumed = false;
+    b.generation++;
+}
+
+/**
+ * Long-Press Timer Fired (timer thread)
+ */
+void GestureEngine::onLongPress(int code, uint64_t generation)
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        Button& b = buttons[code];
+        if (!running || b.generation != generation || !b.held || b.consumed) return;
+        b.longFired = true;
+    }
+
+    if (DEBUG) std::cout << "Gesture: " << EventName(buttons[code].longPressId) << std::endl;
+    push(*timerSource, buttons[code].longPressId, code, 0);
+    dispatcher.Notify();
+}
+
+/**
+ * Double-Tap Window Passed Without a Second Press (timer thread)
+ */
+void GestureEngine::onTapTimeout(int code, uint64_t generation)
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        Button& b = buttons[code];
+        if (!running || b.generation != generation || !b.tapPending) return;
+        b.tapPending = false;
+    }
+
+    if (DEBUG) std::cout << "Gesture: " << EventName(buttons[code].tapId) << std::endl;
+    push(*timerSource, buttons[code].tapId, code, 0);
+    dispatcher.Notify();
+}
+
+/**
+ * Queue a Gesture Event
+ * @param timestampNs Receive timestamp to carry; 0 for timer-decided events, which
+ *                    are stamped with the current time when timestamps are enabled
+ */
+void GestureEngine::push(EventSource& source, uint16_t id, int code, int64_t timestampNs)
+{
+    TourBoxEvent ev = {};
+    ev.id = id;
+    ev.code = (uint8_t)code;
+    ev.kind = EventKind::Gesture;
+    ev.count = 1;
+    ev.timestampNs = timestampNs;
+    if (!timestampNs && timestamps)
+    {
+        ev.timestampNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    dispatcher.Push(source, ev);
+}
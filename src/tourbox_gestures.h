@@ -0,0 +1,72 @@
+#pragma once
+
+#include "tourbox_dispatcher.h"
+#include "tourbox_timer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Per-button gesture thresholds (0 disables that gesture)
+struct GestureSettings
+{
+	bool enabled = false;
+	int tapMs = 300;			// longest press that still counts as a tap
+	int doubleTapMs = 250;		// longest gap between the first release and the second press
+	int longPressMs = 500;		// hold time before "<Button> LongPress"
+};
+
+// Turns press / release of the buttons into "<Button> Tap", "<Button> DoubleTap"
+// and "<Button> LongPress" events, timed on the shared timer wheel
+class GestureEngine
+{
+	public:
+		GestureEngine(TimerWheel& timers, TourBoxDispatcher& dispatcher);
+
+		// Enable gestures for a press code (before Start); button is the name without " Press".
+		// false (gestures stay off) when its event names get no id
+		bool Configure(int code, const std::string& button, const GestureSettings& settings);
+		bool Enabled() const { return anyEnabled; }
+
+		// Start after the timer wheel and dispatcher; stop after the timer wheel
+		void Start(bool timestamps);
+		void Stop();
+
+		// Called by the client threads after the press / release event was queued
+		void OnPress(int code, EventSource& source, int64_t timestampNs);
+		void OnRelease(int code, EventSource& source, int64_t timestampNs);
+
+		// Forget a button without reporting anything (its connection went away)
+		void Cancel(int code);
+
+	private:
+		struct Button
+		{
+			GestureSettings settings;
+			uint16_t tapId = 0;
+			uint16_t doubleTapId = 0;
+			uint16_t longPressId = 0;
+			bool held = false;
+			bool longFired = false;		// this press already produced a LongPress
+			bool consumed = false;		// this press completed a DoubleTap
+			bool tapPending = false;	// a tap is waiting to see if a second one follows
+			uint64_t generation = 0;	// bumped per press / release so stale timers do nothing
+			int64_t pressNs = 0;
+			TimerWheel::TimerId tapTimer = 0;
+		};
+
+		void onLongPress(int code, uint64_t generation);
+		void onTapTimeout(int code, uint64_t generation);
+		void push(EventSource& source, uint16_t id, int code, int64_t timestampNs);
+
+		TimerWheel& timers;
+		TourBoxDispatcher& dispatcher;
+		bool anyEnabled;
+		bool running;
+		bool timestamps;
+		Button buttons[256];
+		std::mutex mutex;
+
+		// Producer for the events decided on the timer thread
+		std::shared_ptr<EventSource> timerSource;
+};
@@ -0,0 +1,118 @@
+#include "tourbox_layers.h"
+
+/**
+ * Constructor - Base Layer Only
+ */
+ControlLayers::ControlLayers() : layerCount(1), active(0), heldLayer(0), toggledLayer(0)
+{
+    for (auto& table : tables)
+    {
+        for (auto& id : table) id = kNoLayerEvent;
+    }
+    for (int i = 0; i < 256; i++)
+    {
+        triggerLayer[i] = 0;
+        pressLayer[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto& mode : modes) mode = LayerMode::Hold;
+}
+
+/**
+ * Define a Layer
+ * @param triggerCode Press code of the button that activates it
+ * @param mode Hold or toggle
+ * @return Layer index (1..kMaxLayers-1), or -1 if all layers are used
+ */
+int ControlLayers::AddLayer(int triggerCode, LayerMode mode)
+{
+    if (layerCount >= kMaxLayers || triggerCode < 0 || triggerCode > 255) return -1;
+
+    int layer = layerCount++;
+    modes[layer] = mode;
+    triggerLayer[triggerCode] = layer;
+    return layer;
+}
+
+/**
+ * Map a Byte on a Layer
+ * @param layer Layer index
+ * @param code Protocol byte
+ * @param eventId Interned event name it produces on that layer
+ */
+void ControlLayers::Map(int layer, int code, uint16_t eventId)
+{
+    if (layer < 0 || layer >= kMaxLayers || code < 0 || code > 255) return;
+    tables[layer][code] = eventId;
+}
+
+/**
+ * Resolve a Byte
+ * @param layer Layer to resolve on
+ * @param code Protocol byte
+ * @param fallback Base event id
+ * @return Layer's event id, or fallback when the layer leaves the byte unmapped
+ */
+uint16_t ControlLayers::Resolve(int layer, int code, uint16_t fallback) const
+{
+    if (layer <= 0 || layer >= kMaxLayers || code < 0 || code > 255) return fallback;
+    uint16_t id = tables[layer][code];
+    return id == kNoLayerEvent ? fallback : id;
+}
+
+/**
+ * Recompute the Active Layer
+ * A held layer wins over the toggled one
+ */
+void ControlLayers::update()
+{
+    int held = heldLayer.load(std::memory_order_relaxed);
+    active.store(held ? held : toggledLayer.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+/**
+ * Button Pressed
+ * @param code Press code
+ * @return Layer the press resolves on (the layer active before any switch it causes)
+ */
+int ControlLayers::OnPress(int code)
+{
+    if (code < 0 || code > 255) return 0;
+
+    int layer = ActiveLayer();
+    pressLayer[code].store((uint8_t)layer, std::memory_order_relaxed);
+
+    int target = triggerLayer[code];
+    if (target)
+    {
+        if (modes[target] == LayerMode::Hold)
+        {
+            heldLayer.store(target, std::memory_order_relaxed);
+        }
+        else
+        {
+            int toggled = toggledLayer.load(std::memory_order_relaxed);
+            toggledLayer.store(toggled == target ? 0 : target, std::memory_order_relaxed);
+        }
+        update();
+    }
+    return layer;
+}
+
+/**
+ * Button Released
+ * @param code Press code of the button
+ * @return Layer its press resolved on, so press and release always pair up
+ */
+int ControlLayers::OnRelease(int code)
+{
+    if (code < 0 || code > 255) return 0;
+
+    int target = triggerLayer[code];
+    if (target && modes[target] == LayerMode::Hold)
+    {
+        int expected = target;
+        heldLayer.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+        update();
+    }
+    return pressLayer[code].load(std::memory_order_relaxed);
+}
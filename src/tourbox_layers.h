@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+const int kMaxLayers = 8;				// layer 0 is the base layer
+const uint16_t kNoLayerEvent = 0xFFFF;	// table entry that falls through to the base name
+
+enum class LayerMode : uint8_t
+{
+	Hold,		// active while the trigger button is held
+	Toggle		// each press of the trigger button switches it on / off
+};
+
+// Keyboard-style mapping layers: the same protocol byte resolves to a
+// different event depending on the active layer
+class ControlLayers
+{
+	public:
+		ControlLayers();
+
+		// Define a layer switched by a button (before StartServer); returns its index or -1 when full
+		int AddLayer(int triggerCode, LayerMode mode);
+
+		// Set the event a byte produces on a layer (before StartServer)
+		void Map(int layer, int code, uint16_t eventId);
+
+		bool Enabled() const { return layerCount > 1; }
+		int ActiveLayer() const { return active.load(std::memory_order_acquire); }
+
+		// Event id for a byte on a layer, or fallback when the layer leaves it unmapped
+		uint16_t Resolve(int layer, int code, uint16_t fallback) const;
+
+		// Press / release of a button (press codes); moves the active layer for trigger buttons
+		// and remembers the layer each press resolved on
+		int OnPress(int code);
+		int OnRelease(int code);
+
+	private:
+		void update();
+
+		uint16_t tables[kMaxLayers][256];
+		int triggerLayer[256];				// layer a press code switches to (0 = none)
+		LayerMode modes[kMaxLayers];
+		int layerCount;
+
+		std::atomic<int> active;
+		std::atomic<int> heldLayer;			// hold layer in effect (0 = none)
+		std::atomic<int> toggledLayer;		// toggled layer (0 = base)
+		std::atomic<uint8_t> pressLayer[256];	// layer each held button was pressed on
+};
@@ -0,0 +1,270 @@
+#include "tourbox_profile.h"
+#include <algorithm>
+
+// Empty slot of the name index
+static const uint16_t kNoName = 0xFFFF;
+
+/**
+ * Constructor - Empty Profile
+ */
+DeviceProfile::DeviceProfile() : nameSeed(0), nameMask(0), nextAxis(AxisDial + 1)
+{
+    for (auto& entry : entries)
+    {
+        entry = ProfileEntry();
+        entry.valid = false;
+        entry.partner = -1;
+    }
+}
+
+/**
+ * Reserve a Code for an Event
+ * @param code Protocol byte
+ * @param eventName Event it decodes to
+ * @param error Set when the code is out of range or either is already used
+ * @return true if the code was free
+ */
+bool DeviceProfile::claim(int code, const std::string& eventName, std::string& error)
+{
+    if (code < 0 || code > 255)
+    {
+        error = "'" + eventName + "': code " + std::to_string(code) + " is not a byte";
+        return false;
+    }
+    if (entries[code].valid)
+    {
+        error = "'" + eventName + "': code " + std::to_string(code) + " is already used by '" + EventName(entries[code].eventId) + "'";
+        return false;
+    }
+    if (std::find(controls.begin(), controls.end(), eventName) != controls.end())
+    {
+        error = "'" + eventName + "' is defined twice";
+        return false;
+    }
+    uint16_t eventId = InternEventName(eventName);
+    if (eventId == kInvalidEventId)
+    {
+        error = "'" + eventName + "': no event id left, at most " + std::to_string(kMaxEventIds) + " event names can exist";
+        return false;
+    }
+
+    entries[code].valid = true;
+    entries[code].eventId = eventId;
+    controls.push_back(eventName);
+    controlCodes.push_back(code);
+    return true;
+}
+
+/**
+ * Build the Perfect-Hash Name Index
+ * Tries seeds for a table of at least twice the name count until every name
+ * lands in its own slot, doubling the table when no seed works. Profiles
+ * hold a few dozen names, so this settles within a handful of tries. Runs
+ * once, after the last AddButton / AddRotary.
+ */
+void DeviceProfile::Finish()
+{
+    uint32_t size = 4;
+    while (size < controls.size() * 2) size <<= 1;
+
+    for (;;)
+    {
+        for (uint32_t seed = 0; seed < 256; seed++)
+        {
+            nameSlots.assign(size, kNoName);
+            bool collision = false;
+            for (size_t i = 0; i < controls.size() && !collision; i++)
+            {
+                const std::string& name = controls[i];
+                uint16_t& slot = nameSlots[ControlNameHash(name.data(), name.size(), seed) & (size - 1)];
+                if (slot != kNoName) collision = true;
+                slot = (uint16_t)i;
+            }
+            if (!collision)
+            {
+                nameSeed = seed;
+                nameMask = size - 1;
+                return;
+            }
+        }
+        size <<= 1;
+    }
+}
+
+/**
+ * Add a Button
+ * @param button Button name
+ * @param pressCode Byte sent when it goes down
+ * @param releaseCode Byte sent when it comes up (-1 = none)
+ * @param pressName Press event name (empty = "<button> Press")
+ * @param releaseName Release event name (empty = "<button> Release")
+ * @param error Receives the reason on failure
+ */
+bool DeviceProfile::AddButton(const std::string& button, int pressCode, int releaseCode,
+                              const std::string& pressName, const std::string& releaseName, std::string& error)
+{
+    if (!claim(pressCode, pressName.empty() ? button + " Press" : pressName, error)) return false;
+    entries[pressCode].kind = EventKind::Press;
+    entries[pressCode].partner = (int16_t)releaseCode;
+
+    if (releaseCode >= 0)
+    {
+        if (!claim(releaseCode, releaseName.empty() ? button + " Release" : releaseName, error)) return false;
+        entries[releaseCode].kind = EventKind::Release;
+        entries[releaseCode].partner = (int16_t)pressCode;
+    }
+
+    buttons.push_back(ProfileButton{button, pressCode, releaseCode});
+    return true;
+}
+
+/**
+ * Add a Rotary Control
+ * @param rotary Control name; "Knob", "Scroll" and "Dial" keep their fixed axes, others get the next free one
+ * @param positiveCode Byte per clockwise / up step
+ * @param negativeCode Byte per counter-clockwise / down step
+ * @param positiveName Event name (empty = "<rotary> CW")
+ * @param negativeName Event name (empty = "<rotary> CCW")
+ * @param error Receives the reason on failure
+ */
+bool DeviceProfile::AddRotary(const std::string& rotary, int positiveCode, int negativeCode,
+                              const std::string& positiveName, const std::string& negativeName, std::string& error)
+{
+    uint8_t axis = rotary == "Knob" ? AxisKnob : rotary == "Scroll" ? AxisScroll : rotary == "Dial" ? AxisDial : AxisNone;
+    if (axis == AxisNone)
+    {
+        if (nextAxis >= kMaxRotationAxes)
+        {
+            error = "'" + rotary + "': at most " + std::to_string(kMaxRotationAxes - 1) + " rotary controls are supported";
+            return false;
+        }
+        axis = nextAxis++;
+    }
+    if (AxisOf(rotary) != AxisNone)
+    {
+        error = "'" + rotary + "' is defined twice";
+        return false;
+    }
+
+    if (!claim(positiveCode, positiveName.empty() ? rotary + " CW" : positiveName, error)) return false;
+    if (!claim(negativeCode, negativeName.empty() ? rotary + " CCW" : negativeName, error)) return false;
+
+    entries[positiveCode].kind = EventKind::Rotation;
+    entries[positiveCode].axis = axis;
+    entries[positiveCode].direction = 1;
+    entries[negativeCode].kind = EventKind::Rotation;
+    entries[negativeCode].axis = axis;
+    entries[negativeCode].direction = -1;
+
+    rotaries.push_back(ProfileRotary{rotary, axis, positiveCode, negativeCode});
+    return true;
+}
+
+/**
+ * Find the Code of an Event Name
+ * @return Protocol byte, or -1 if the profile has no such event
+ */
+int DeviceProfile::CodeOf(const std::string& eventName) const
+{
+    if (nameSlots.empty()) return -1;
+
+    uint16_t index = nameSlots[ControlNameHash(eventName.data(), eventName.size(), nameSeed) & nameMask];
+    return (index != kNoName && controls[index] == eventName) ? controlCodes[index] : -1;
+}
+
+/**
+ * Find a Button by Name
+ */
+const ProfileButton* DeviceProfile::FindButton(const std::string& button) const
+{
+    for (const auto& b : buttons)
+    {
+        if (b.name == button) return &b;
+    }
+    return nullptr;
+}
+
+/**
+ * Axis of a Rotary Control
+ */
+uint8_t DeviceProfile::AxisOf(const std::string& rotary) const
+{
+    for (const auto& r : rotaries)
+    {
+        if (r.name == rotary) return r.axis;
+    }
+    return AxisNone;
+}
+
+/**
+ * Built-in Profile
+ * @return Shared, immutable TourBox Neo / Elite profile (created once)
+ */
+std::shared_ptr<const DeviceProfile> DeviceProfile::Builtin()
+{
+    static std::shared_ptr<const DeviceProfile> builtin = []()
+    {
+        auto profile = std::make_shared<DeviceProfile>();
+        profile->name = "TourBox";
+        std::string error;
+
+        for (const BuiltinRotary& r : kBuiltinRotaries)
+        {
+            profile->AddRotary(r.name, r.positiveCode, r.negativeCode, r.positiveName, r.negativeName, error);
+        }
+        for (const BuiltinButton& b : kBuiltinButtons)
+        {
+            profile->AddButton(b.name, b.pressCode, b.releaseCode, "", "", error);
+        }
+        profile->Finish();
+        return std::shared_ptr<const DeviceProfile>(profile);
+    }();
+    return builtin;
+}
+
+/**
+ * Constructor - Start With a Profile
+ * @param initial Active profile until the first Publish
+ */
+ProfileTable::ProfileTable(std::shared_ptr<const DeviceProfile> initial) : active(initial.get()), owner(std::move(initial))
+{
+}
+
+/**
+ * Destructor
+ * The domain frees whatever is still retired; owner releases the active profile
+ */
+ProfileTable::~ProfileTable()
+{
+}
+
+/**
+ * Publish a Profile
+ * @param profile Replacement; ignored if null
+ *
+ * The old profile's reference moves into the retire callback, so it stays
+ * alive for readers that loaded it before the swap.
+ */
+void ProfileTable::Publish(std::shared_ptr<const DeviceProfile> profile)
+{
+    if (!profile) return;
+
+    std::shared_ptr<const DeviceProfile> previous;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        previous = std::move(owner);
+        owner = std::move(profile);
+        active.store(owner.get(), std::memory_order_seq_cst);
+    }
+    rcu.Retire([previous]() mutable { previous.reset(); });
+}
+
+/**
+ * Active Profile
+ * @return Shared reference, safe to keep on any thread
+ */
+std::shared_ptr<const DeviceProfile> ProfileTable::Current() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return owner;
+}
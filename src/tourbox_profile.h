@@ -0,0 +1,123 @@
+#pragma once
+
+#include "tourbox_controls.h"
+#include "tourbox_events.h"
+#include "tourbox_rcu.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Decoded meaning of one protocol byte
+struct ProfileEntry
+{
+	bool valid;				// byte is part of the profile
+	EventKind kind;			// Press / Release / Rotation
+	uint16_t eventId;		// interned event name
+	uint8_t axis;			// RotationAxis for rotations
+	int8_t direction;		// +1 clockwise / up, -1 counter-clockwise / down
+	int16_t partner;		// press: its release code, release: its press code (-1 = none)
+};
+
+// A button as defined by a profile
+struct ProfileButton
+{
+	std::string name;		// e.g. "Tall" (events "Tall Press" / "Tall Release")
+	int pressCode;
+	int releaseCode;		// -1 for press-only buttons
+};
+
+// A rotary control as defined by a profile
+struct ProfileRotary
+{
+	std::string name;		// e.g. "Knob"
+	uint8_t axis;
+	int positiveCode;		// clockwise / up
+	int negativeCode;
+};
+
+// Byte-to-control mapping of one device model, compiled into a flat 256-entry table
+// so decoding a byte is a single table load. Immutable once Finish() has run.
+class DeviceProfile : public std::enable_shared_from_this<DeviceProfile>
+{
+	public:
+		DeviceProfile();
+
+		std::string name;
+
+		// Build the profile; false (and error) on bad or duplicate codes / names
+		bool AddButton(const std::string& button, int pressCode, int releaseCode,
+		               const std::string& pressName, const std::string& releaseName, std::string& error);
+		bool AddRotary(const std::string& rotary, int positiveCode, int negativeCode,
+		               const std::string& positiveName, const std::string& negativeName, std::string& error);
+
+		// Build the name index once every control is added; CodeOf finds nothing before this
+		void Finish();
+
+		// Decode a byte (null when the profile does not define it)
+		const ProfileEntry* Lookup(int code) const
+		{
+			return (code >= 0 && code < 256 && entries[code].valid) ? &entries[code] : nullptr;
+		}
+
+		// Code for an event name ("Tall Press"), or -1; one hash probe and one compare
+		int CodeOf(const std::string& eventName) const;
+
+		// Button by name ("Tall"), or null
+		const ProfileButton* FindButton(const std::string& button) const;
+
+		// Axis of a rotary control ("Knob"), or AxisNone
+		uint8_t AxisOf(const std::string& rotary) const;
+
+		// Event names in definition order
+		const std::vector<std::string>& Controls() const { return controls; }
+		const std::vector<ProfileButton>& Buttons() const { return buttons; }
+		const std::vector<ProfileRotary>& Rotaries() const { return rotaries; }
+
+		// The TourBox Neo / Elite layout this addon has always decoded (tourbox_controls.h)
+		static std::shared_ptr<const DeviceProfile> Builtin();
+
+	private:
+		bool claim(int code, const std::string& eventName, std::string& error);
+
+		ProfileEntry entries[256];
+		std::vector<std::string> controls;
+		std::vector<int> controlCodes;
+
+		// Perfect hash over the event names: the seed is chosen so no two names share a slot
+		std::vector<uint16_t> nameSlots;	// index into controls, kNoName when empty
+		uint32_t nameSeed;
+		uint32_t nameMask;
+		std::vector<ProfileButton> buttons;
+		std::vector<ProfileRotary> rotaries;
+		uint8_t nextAxis;
+};
+
+// The server's active profile, replaceable while clients are connected. Readers load a
+// plain pointer with no locking; replaced profiles are freed through RCU once no reader
+// can still be decoding with them.
+class ProfileTable
+{
+	public:
+		explicit ProfileTable(std::shared_ptr<const DeviceProfile> initial);
+		~ProfileTable();
+
+		// Reader (while its RcuReader is online): valid until the reader next goes offline
+		const DeviceProfile* Read() const { return active.load(std::memory_order_seq_cst); }
+
+		// Writer: swap in a new profile; readers pick it up when they next come online
+		void Publish(std::shared_ptr<const DeviceProfile> profile);
+
+		// Writer side / slow paths: the active profile, kept alive by the caller
+		std::shared_ptr<const DeviceProfile> Current() const;
+
+		RcuDomain& Rcu() { return rcu; }
+
+	private:
+		RcuDomain rcu;
+		std::atomic<const DeviceProfile*> active;
+		std::shared_ptr<const DeviceProfile> owner;		// guarded by lock
+		mutable std::mutex lock;
+};
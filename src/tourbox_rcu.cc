@@ -0,0 +1,115 @@
+#include "tourbox_rcu.h"
+#include <algorithm>
+#include <limits>
+
+/**
+ * Come Online
+ * Records the current epoch. The store must be ordered before the reader's
+ * next pointer loads (which are seq_cst too), or a writer scanning in between
+ * could see the reader offline while it picks up the old pointer.
+ */
+void RcuReader::Online()
+{
+    seen.store(domain->epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+}
+
+/**
+ * Constructor - Empty Domain
+ * Epoch 0 is reserved for "offline", so counting starts at 1
+ */
+RcuDomain::RcuDomain() : epoch(1)
+{
+}
+
+/**
+ * Destructor - Free Everything Still Retired
+ * Readers are gone by now (their threads were joined with the server's)
+ */
+RcuDomain::~RcuDomain()
+{
+    for (auto& entry : retired) entry.second();
+}
+
+/**
+ * Register a Reader Thread
+ * @return Record the thread announces its state through (starts offline)
+ */
+RcuReader* RcuDomain::RegisterReader()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    readers.emplace_back(new RcuReader(this));
+    return readers.back().get();
+}
+
+/**
+ * Unregister a Reader Thread
+ * @param reader Record from RegisterReader; the thread holds no protected pointers
+ *
+ * A departing reader can be what a grace period was waiting for, so this
+ * also reclaims.
+ */
+void RcuDomain::UnregisterReader(RcuReader* reader)
+{
+    if (!reader) return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        readers.erase(std::remove_if(readers.begin(), readers.end(),
+                                     [reader](const std::unique_ptr<RcuReader>& r) { return r.get() == reader; }),
+                      readers.end());
+    }
+    Reclaim();
+}
+
+/**
+ * Retire an Unpublished Object
+ * @param reclaim Frees it; runs once no reader can still hold it
+ *
+ * Advancing the epoch after the caller's publish means a reader that has
+ * seen the new epoch also sees the new pointer.
+ */
+void RcuDomain::Retire(std::function<void()> reclaim)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        uint64_t retiredAt = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        retired.emplace_back(retiredAt, std::move(reclaim));
+    }
+    Reclaim();
+}
+
+/**
+ * Reclaim Past Grace Periods
+ * An object retired at epoch E is unreachable once every online reader has
+ * observed E or later; offline readers hold nothing. Reclaims run outside
+ * the lock so they may free arbitrary objects.
+ */
+void RcuDomain::Reclaim()
+{
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const auto& reader : readers)
+        {
+            uint64_t seen = reader->seen.load(std::memory_order_acquire);
+            if (seen != 0) oldest = std::min(oldest, seen);
+        }
+
+        auto it = retired.begin();
+        while (it != retired.end())
+        {
+            if (it->first <= oldest)
+            {
+                ready.push_back(std::move(it->second));
+                it = retired.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    for (auto& reclaim : ready) reclaim();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class RcuDomain;
+
+// One reader thread's quiescent-state record. Touched only by its own thread on the
+// read side; writers just scan it.
+class RcuReader
+{
+	public:
+		// About to read protected pointers (after waking up); pairs with a writer's publish
+		void Online();
+
+		// Holds no protected pointers, e.g. before blocking in recv(): writers need not wait for it
+		void Offline() { seen.store(0, std::memory_order_release); }
+
+	private:
+		friend class RcuDomain;
+		explicit RcuReader(RcuDomain* d) : domain(d), seen(0) {}
+
+		RcuDomain* domain;
+		alignas(64) std::atomic<uint64_t> seen;	// epoch observed when last online, 0 = offline
+};
+
+// Quiescent-state-based reclamation: writers swap a pointer and retire the old object,
+// which is freed once every reader that was online has gone offline or come back online
+// after the swap. Readers never lock, retry or write shared cache lines.
+class RcuDomain
+{
+	public:
+		RcuDomain();
+		~RcuDomain();
+
+		// Reader threads register once and announce state through the returned record
+		RcuReader* RegisterReader();
+		void UnregisterReader(RcuReader* reader);
+
+		// Writer: call after publishing the replacement; reclaim runs after the grace period
+		void Retire(std::function<void()> reclaim);
+
+		// Writer: run every reclaim whose grace period has passed
+		void Reclaim();
+
+	private:
+		friend class RcuReader;
+
+		std::atomic<uint64_t> epoch;
+		std::mutex lock;
+		std::vector<std::unique_ptr<RcuReader>> readers;
+		std::vector<std::pair<uint64_t, std::function<void()>>> retired;
+};
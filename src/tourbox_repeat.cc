@@ -0,0 +1,142 @@
+#include "tourbox_repeat.h"
+#include <chrono>
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+/**
+ * Constructor
+ * @param timerWheel Shared timer thread that paces the repeats
+ * @param eventDispatcher Dispatcher the repeat events are queued on
+ */
+AutoRepeater::AutoRepeater(TimerWheel& timerWheel, TourBoxDispatcher& eventDispatcher)
+    : timers(timerWheel), dispatcher(eventDispatcher), anyEnabled(false), running(false), timestamps(false)
+{
+}
+
+/**
+ * Configure a Button
+ * @param code Press code
+ * @param button Name used for the event, e.g. "Up" gives "Up Repeat"
+ * @param settings Delay and interval
+ * @return false if no event id was left for the repeat name
+ */
+bool AutoRepeater::Configure(int code, const std::string& button, const RepeatSettings& settings)
+{
+    if (code < 0 || code > 255) return true;
+
+    buttons[code].settings = settings;
+    buttons[code].eventId = InternEventName(button + " Repeat");
+    if (buttons[code].eventId == kInvalidEventId)
+    {
+        buttons[code].settings.enabled = false;
+        return false;
+    }
+    if (settings.enabled && settings.intervalMs > 0) anyEnabled = true;
+    else buttons[code].settings.enabled = false;
+    return true;
+}
+
+/**
+ * Start Producing Events
+ * @param stampEvents Stamp repeats with the current time (timestamps option)
+ */
+void AutoRepeater::Start(bool stampEvents)
+{
+    if (!anyEnabled || running) return;
+    timestamps = stampEvents;
+    timerSource = dispatcher.Register();
+
+    std::lock_guard<std::mutex> g(mutex);
+    running = true;
+}
+
+/**
+ * Stop Producing Events
+ * The timer wheel must already be stopped, so nothing pushes into the source anymore
+ */
+void AutoRepeater::Stop()
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        if (!running) return;
+        running = false;
+        for (Button& b : buttons)
+        {
+            b.held = false;
+            b.generation++;
+        }
+    }
+    dispatcher.Unregister(timerSource);
+    timerSource.reset();
+}
+
+/**
+ * Held State Changed
+ * @param code Press code
+ * @param held true on press, false on release or when the connection holding it went away
+ *
+ * Releasing only bumps the generation: a repeat already scheduled finds it
+ * stale and does nothing, so no repeat follows the release
+ */
+void AutoRepeater::SetHeld(int code, bool held)
+{
+    if (code < 0 || code > 255 || !buttons[code].settings.enabled) return;
+
+    uint64_t generation;
+    int delayMs;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        if (!running) return;
+
+        Button& b = buttons[code];
+        if (b.held == held) return;
+        b.held = held;
+        generation = ++b.generation;
+        if (!held) return;
+
+        b.repeats = 0;
+        b.nextDueNs = steadyNowNs() + (int64_t)b.settings.delayMs * 1000000;
+        delayMs = b.settings.delayMs;
+    }
+
+    timers.Schedule(delayMs, [this, code, generation]() { onRepeat(code, generation); });
+}
+
+/**
+ * Repeat Timer Fired (timer thread)
+ * Emits one repeat and schedules the next against the ideal due time, so
+ * timer lateness does not accumulate into the cadence
+ */
+void AutoRepeater::onRepeat(int code, uint64_t generation)
+{
+    TourBoxEvent ev = {};
+    int64_t delayMs;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        Button& b = buttons[code];
+        if (!running || b.generation != generation || !b.held) return;
+
+        ev.id = b.eventId;
+        ev.code = (uint8_t)code;
+        ev.kind = EventKind::Gesture;
+        ev.count = ++b.repeats;
+
+        int64_t now = steadyNowNs();
+        int64_t interval = (int64_t)b.settings.intervalMs * 1000000;
+        b.nextDueNs += interval;
+        if (b.nextDueNs < now) b.nextDueNs = now + interval;	// fell behind, skip instead of bursting
+        delayMs = (b.nextDueNs - now) / 1000000;
+    }
+
+    if (timestamps)
+    {
+        ev.timestampNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    if (DEBUG) std::cout << EventName(ev.id) << " #" << ev.count << std::endl;
+
+    dispatcher.Push(*timerSource, ev);
+    dispatcher.Notify();
+    timers.Schedule(delayMs, [this, code, generation]() { onRepeat(code, generation); });
+}
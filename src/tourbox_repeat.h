@@ -0,0 +1,59 @@
+#pragma once
+
+#include "tourbox_dispatcher.h"
+#include "tourbox_timer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Keyboard-style auto-repeat settings for one button
+struct RepeatSettings
+{
+	bool enabled = false;
+	int delayMs = 400;			// hold time before the first repeat
+	int intervalMs = 33;		// time between repeats
+};
+
+// Emits "<Button> Repeat" while a button stays held, from the shared timer thread
+class AutoRepeater
+{
+	public:
+		AutoRepeater(TimerWheel& timers, TourBoxDispatcher& dispatcher);
+
+		// Enable auto-repeat for a press code (before Start); button is the name without " Press".
+		// false (repeat stays off) when its event name gets no id
+		bool Configure(int code, const std::string& button, const RepeatSettings& settings);
+		bool Enabled() const { return anyEnabled; }
+
+		// Start after the timer wheel and dispatcher; stop after the timer wheel
+		void Start(bool timestamps);
+		void Stop();
+
+		// Follows the server's held state: starts the cycle on press, ends it on release / disconnect
+		void SetHeld(int code, bool held);
+
+	private:
+		struct Button
+		{
+			RepeatSettings settings;
+			uint16_t eventId = 0;
+			bool held = false;
+			uint64_t generation = 0;	// bumped per press / release so stale timers do nothing
+			int32_t repeats = 0;
+			int64_t nextDueNs = 0;
+		};
+
+		void onRepeat(int code, uint64_t generation);
+
+		TimerWheel& timers;
+		TourBoxDispatcher& dispatcher;
+		bool anyEnabled;
+		bool running;
+		bool timestamps;
+		Button buttons[256];
+		std::mutex mutex;
+
+		// Producer for repeat events (timer thread only)
+		std::shared_ptr<EventSource> timerSource;
+};
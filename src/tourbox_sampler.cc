@@ -0,0 +1,221 @@
+#include "tourbox_sampler.h"
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+    #include <sys/timerfd.h>
+    #include <unistd.h>
+#endif
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+/**
+ * Return a Record's Delivery Slot
+ * Lets the sampler publish again; until then ticks keep accumulating
+ */
+void SampleRecord::Delivered()
+{
+    if (inFlight) inFlight->store(false, std::memory_order_release);
+}
+
+/**
+ * Constructor - Sampling Off
+ */
+StateSampler::StateSampler() : rateHz(0), profiles(nullptr), owner(0), running(false), held(0), pressed(0),
+    rcuReader(nullptr), inFlight(std::make_shared<std::atomic<bool>>(false)), lastHeld(0), missedTicks(0)
+{
+    for (int i = 0; i < kMaxRotationAxes; i++)
+    {
+        delta[i].store(0.0, std::memory_order_relaxed);
+        steps[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Destructor - Stop the Timer Thread
+ */
+StateSampler::~StateSampler()
+{
+    Stop();
+}
+
+/**
+ * Start the Timer Thread
+ * @param placement CPU / scheduling placement for the thread
+ * @param threadName Name shown in debuggers and profilers
+ */
+void StateSampler::Start(const ThreadPlacement& placement, const std::string& threadName)
+{
+    if (running || !Enabled()) return;
+    running = true;
+    thread = std::thread([this, placement, threadName]()
+    {
+        ApplyThreadPlacement(placement, threadName);
+        rcuReader = profiles ? profiles->Rcu().RegisterReader() : nullptr;
+        Run();
+        if (profiles) profiles->Rcu().UnregisterReader(rcuReader);
+    });
+}
+
+/**
+ * Stop the Timer Thread
+ * Returns within one tick period
+ */
+void StateSampler::Stop()
+{
+    running = false;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+/**
+ * Accumulate a Rotation
+ * @param axis RotationAxis the steps belong to
+ * @param stepCount Signed raw steps
+ * @param amount Signed delta (scaled when acceleration is on)
+ */
+void StateSampler::AddRotation(uint8_t axis, int32_t stepCount, double amount)
+{
+    if (axis >= kMaxRotationAxes) return;
+
+    steps[axis].fetch_add(stepCount, std::memory_order_relaxed);
+    double current = delta[axis].load(std::memory_order_relaxed);
+    while (!delta[axis].compare_exchange_weak(current, current + amount, std::memory_order_relaxed))
+    {
+    }
+}
+
+/**
+ * Track a Button
+ * @param code Press code of the button
+ * @param isHeld New state
+ */
+void StateSampler::SetHeld(int code, bool isHeld)
+{
+    if (code < 0 || code >= kMaxSampleCodes) return;
+
+    uint64_t bit = 1ULL << code;
+    if (isHeld)
+    {
+        held.fetch_or(bit, std::memory_order_relaxed);
+        pressed.fetch_or(bit, std::memory_order_relaxed);
+    }
+    else
+    {
+        held.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Timer Loop
+ * Uses a periodic timerfd on Linux so ticks stay on the kernel's schedule,
+ * elsewhere sleeps until the next absolute tick time
+ */
+void StateSampler::Run()
+{
+    auto period = std::chrono::nanoseconds((int64_t)(1e9 / rateHz));
+
+#ifdef __linux__
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (fd >= 0)
+    {
+        itimerspec spec = {};
+        spec.it_interval.tv_sec = (time_t)(period.count() / 1000000000);
+        spec.it_interval.tv_nsec = (long)(period.count() % 1000000000);
+        spec.it_value = spec.it_interval;
+
+        if (timerfd_settime(fd, 0, &spec, nullptr) == 0)
+        {
+            while (running)
+            {
+                uint64_t expirations = 0;
+                if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                tick(expirations);
+            }
+            close(fd);
+            return;
+        }
+
+        if (DEBUG) std::cerr << "timerfd_settime failed, falling back to sleep" << std::endl;
+        close(fd);
+    }
+#endif
+
+    auto next = std::chrono::steady_clock::now() + period;
+    while (running)
+    {
+        std::this_thread::sleep_until(next);
+
+        // Count the periods that passed while this thread was not running
+        uint64_t expirations = 1;
+        auto now = std::chrono::steady_clock::now();
+        while (next + period <= now)
+        {
+            next += period;
+            expirations++;
+        }
+        next += period;
+
+        tick(expirations);
+    }
+}
+
+/**
+ * Publish One Record
+ * @param expirations Timer periods since the previous tick (more than 1 when ticks were missed)
+ *
+ * When JavaScript has not run the previous record yet nothing is taken, so
+ * the totals roll into the next tick instead of queueing. Idle ticks (no
+ * movement, no press and no change in the held set) publish nothing.
+ */
+void StateSampler::tick(uint64_t expirations)
+{
+    missedTicks += (uint32_t)(expirations - 1);
+    if (inFlight->load(std::memory_order_acquire))
+    {
+        missedTicks++;
+        return;
+    }
+
+    SampleRecord* record = new SampleRecord();
+    bool changed = false;
+    for (int i = 0; i < kMaxRotationAxes; i++)
+    {
+        record->steps[i] = steps[i].exchange(0, std::memory_order_relaxed);
+        record->delta[i] = delta[i].exchange(0.0, std::memory_order_relaxed);
+        if (record->steps[i] != 0 || record->delta[i] != 0) changed = true;
+    }
+    record->pressed = pressed.exchange(0, std::memory_order_relaxed);
+    record->held = held.load(std::memory_order_relaxed);
+    if (record->pressed != 0 || record->held != lastHeld) changed = true;
+
+    if (!changed)
+    {
+        delete record;
+        missedTicks = 0;
+        return;
+    }
+
+    // Only the moment of the copy needs the profile table, so the thread is otherwise offline
+    if (rcuReader)
+    {
+        rcuReader->Online();
+        record->profile = profiles->Read()->shared_from_this();
+        rcuReader->Offline();
+    }
+    else
+    {
+        record->profile = DeviceProfile::Builtin();
+    }
+    record->timestampNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record->missedTicks = missedTicks;
+    record->inFlight = inFlight;
+    lastHeld = record->held;
+    missedTicks = 0;
+
+    inFlight->store(true, std::memory_order_release);
+    DeliverSample(owner, record);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "tourbox_events.h"
+#include "tourbox_profile.h"
+#include "tourbox_thread.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Consolidated input state for one sampling tick
+struct SampleRecord
+{
+	double delta[kMaxRotationAxes];		// net signed delta per RotationAxis (scaled when accelerated)
+	int32_t steps[kMaxRotationAxes];	// net raw steps per RotationAxis
+	uint64_t held;						// bit per press code currently held
+	uint64_t pressed;					// bit per press code that went down since the last record
+	int64_t timestampNs;				// tick time, ns since the Unix epoch
+	uint32_t missedTicks;				// ticks folded into this record because JavaScript was busy
+	std::shared_ptr<std::atomic<bool>> inFlight;
+	std::shared_ptr<const DeviceProfile> profile;	// names the axes and codes above
+
+	// Called once JavaScript has run the record (or it was dropped)
+	void Delivered();
+};
+
+// Hand a sample of server owner to Node.js, taking ownership (defined in tourbox_addon.cc)
+extern void DeliverSample(int owner, SampleRecord* record);
+
+// Press codes the held / pressed masks can represent
+const int kMaxSampleCodes = 64;
+
+// Publishes the accumulated input state at a fixed rate from its own timer thread
+class StateSampler
+{
+	public:
+		StateSampler();
+		~StateSampler();
+
+		// Ticks per second (0 = off); set before Start
+		void SetRate(double hz) { rateHz = hz; }
+		bool Enabled() const { return rateHz > 0; }
+
+		// Profile table whose active profile is attached to each record; set before Start
+		void SetProfiles(ProfileTable* table) { profiles = table; }
+
+		// Server id passed to DeliverSample; set before Start
+		void SetOwner(int id) { owner = id; }
+
+		void Start(const ThreadPlacement& placement, const std::string& threadName);
+		void Stop();
+
+		// Producers (I/O threads)
+		void AddRotation(uint8_t axis, int32_t steps, double delta);
+		void SetHeld(int code, bool held);
+
+	private:
+		void Run();
+		void tick(uint64_t expirations);
+
+		double rateHz;
+		ProfileTable* profiles;
+		int owner;
+		std::atomic<bool> running;
+		std::thread thread;
+
+		std::atomic<double> delta[kMaxRotationAxes];
+		std::atomic<int32_t> steps[kMaxRotationAxes];
+		std::atomic<uint64_t> held;
+		std::atomic<uint64_t> pressed;
+
+		// Timer thread only
+		RcuReader* rcuReader;
+		std::shared_ptr<std::atomic<bool>> inFlight;
+		uint64_t lastHeld;
+		uint32_t missedTicks;
+};
@@ -0,0 +1,191 @@
+#include "tourbox_sequences.h"
+#include "tourbox_events.h"
+#include <map>
+#include <queue>
+
+/**
+ * Constructor - No Sequences
+ */
+SequenceMatcher::SequenceMatcher() : alphabetSize(0), maxGapNs(0)
+{
+}
+
+/**
+ * Register a Sequence
+ * @param definition Steps, timeouts and the event to emit
+ * @return false if the sequence is empty or longer than kMaxSequenceLength
+ */
+bool SequenceMatcher::Add(const SequenceDefinition& definition)
+{
+    if (definition.steps.empty() || definition.steps.size() > (size_t)kMaxSequenceLength) return false;
+
+    SequenceDefinition d = definition;
+    d.stepTimeoutMs.resize(d.steps.size() - 1, 0);
+    definitions.push_back(d);
+    return true;
+}
+
+/**
+ * Build the Automaton
+ * Trie of all sequences, failure links by breadth-first search, then a
+ * dense transition table so Advance() never follows failure links
+ */
+void SequenceMatcher::Compile()
+{
+    symbolOf.assign(kMaxEventIds, -1);
+    alphabetSize = 0;
+    for (const auto& d : definitions)
+    {
+        for (uint16_t id : d.steps)
+        {
+            if (id < kMaxEventIds && symbolOf[id] < 0) symbolOf[id] = alphabetSize++;
+        }
+    }
+
+    // Longest gap any sequence allows between two steps (an edge is bounded by
+    // its own timeout and by the sequence window); beyond it Advance() restarts
+    maxGapNs = 0;
+    bool unlimited = false;
+    for (const auto& d : definitions)
+    {
+        for (int edge : d.stepTimeoutMs)
+        {
+            int limit = edge > 0 ? edge : 0;
+            if (d.windowMs > 0 && (limit == 0 || d.windowMs < limit)) limit = d.windowMs;
+            if (limit == 0) unlimited = true;
+            else if ((int64_t)limit * 1000000 > maxGapNs) maxGapNs = (int64_t)limit * 1000000;
+        }
+    }
+    if (unlimited) maxGapNs = 0;
+
+    // Trie
+    std::vector<std::map<int, int>> children(1);
+    outputs.assign(1, std::vector<int>());
+    for (size_t i = 0; i < definitions.size(); i++)
+    {
+        int node = 0;
+        for (uint16_t id : definitions[i].steps)
+        {
+            int symbol = symbolOf[id];
+            auto it = children[node].find(symbol);
+            if (it == children[node].end())
+            {
+                children.push_back(std::map<int, int>());
+                outputs.push_back(std::vector<int>());
+                int child = (int)children.size() - 1;
+                children[node][symbol] = child;
+                node = child;
+            }
+            else
+            {
+                node = it->second;
+            }
+        }
+        outputs[node].push_back((int)i);
+    }
+
+    // Failure links and the dense table, level by level
+    size_t nodes = children.size();
+    std::vector<int> fail(nodes, 0);
+    transitions.assign(nodes * alphabetSize, 0);
+    std::queue<int> pending;
+
+    for (const auto& edge : children[0])
+    {
+        transitions[edge.first] = edge.second;
+        pending.push(edge.second);
+    }
+
+    while (!pending.empty())
+    {
+        int node = pending.front();
+        pending.pop();
+
+        const std::vector<int>& inherited = outputs[fail[node]];
+        outputs[node].insert(outputs[node].end(), inherited.begin(), inherited.end());
+
+        for (int symbol = 0; symbol < alphabetSize; symbol++)
+        {
+            auto it = children[node].find(symbol);
+            if (it != children[node].end())
+            {
+                fail[it->second] = transitions[fail[node] * alphabetSize + symbol];
+                transitions[node * alphabetSize + symbol] = it->second;
+                pending.push(it->second);
+            }
+            else
+            {
+                transitions[node * alphabetSize + symbol] = transitions[fail[node] * alphabetSize + symbol];
+            }
+        }
+    }
+}
+
+/**
+ * Check a Completed Sequence's Timing
+ * @param definition Sequence that ends at the current event
+ * @param state Recent arrival times
+ * @return true if every gap and the whole window are within limits
+ */
+bool SequenceMatcher::timingMatches(const SequenceDefinition& definition, const SequenceState& state) const
+{
+    int length = (int)definition.steps.size();
+    if (state.count < length) return false;
+
+    auto timeAt = [&state](int back) { return state.times[(state.count - 1 - back) % kMaxSequenceLength]; };
+
+    int64_t last = timeAt(0);
+    int64_t first = timeAt(length - 1);
+    if (definition.windowMs > 0 && last - first > (int64_t)definition.windowMs * 1000000) return false;
+
+    // Edge i joins step i and step i + 1
+    for (int i = 0; i < length - 1; i++)
+    {
+        int limit = definition.stepTimeoutMs[i];
+        if (limit <= 0) continue;
+        int64_t gap = timeAt(length - 2 - i) - timeAt(length - 1 - i);
+        if (gap > (int64_t)limit * 1000000) return false;
+    }
+    return true;
+}
+
+/**
+ * Advance by One Event
+ * @param state Connection's position
+ * @param eventId Event that was just queued
+ * @param nowNs Monotonic arrival time
+ * @param matches Receives the events of sequences completed by this event
+ *
+ * Every sequence that ends here is reported (one may be a suffix of
+ * another); after a match the automaton starts over.
+ */
+void SequenceMatcher::Advance(SequenceState& state, uint16_t eventId, int64_t nowNs, std::vector<uint16_t>& matches) const
+{
+    if (alphabetSize == 0) return;
+
+    // Too long since the previous event for any sequence to continue
+    if (maxGapNs > 0 && state.count > 0 && nowNs - state.times[(state.count - 1) % kMaxSequenceLength] > maxGapNs)
+    {
+        state.node = 0;
+    }
+
+    state.times[state.count % kMaxSequenceLength] = nowNs;
+    state.count++;
+
+    int symbol = eventId < kMaxEventIds ? symbolOf[eventId] : -1;
+    state.node = symbol < 0 ? 0 : transitions[state.node * alphabetSize + symbol];
+
+    bool matched = false;
+    for (int index : outputs[state.node])
+    {
+        const SequenceDefinition& d = definitions[index];
+        if (timingMatches(d, state))
+        {
+            matches.push_back(d.eventId);
+            matched = true;
+        }
+    }
+
+    // Like a keyboard shortcut, the steps that completed a sequence are used up
+    if (matched) state.node = 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const int kMaxSequenceLength = 16;
+
+// One registered shortcut
+struct SequenceDefinition
+{
+	uint16_t eventId = 0;				// event emitted on a match
+	std::vector<uint16_t> steps;		// event ids to match, in order
+	std::vector<int> stepTimeoutMs;		// per edge: max gap before step i+1 (0 = unlimited), size steps-1
+	int windowMs = 0;					// max time from first to last step (0 = unlimited)
+};
+
+// Per-connection position in the automaton
+struct SequenceState
+{
+	int node = 0;
+	int64_t times[kMaxSequenceLength] = {};	// arrival time of the last steps (ring)
+	int count = 0;							// events fed so far (ring position)
+};
+
+// All sequences compiled into one Aho-Corasick automaton over event ids.
+// Each fed event costs one table lookup; timing is checked only when a
+// node completes a sequence, against the recent arrival times.
+class SequenceMatcher
+{
+	public:
+		SequenceMatcher();
+
+		// Register a sequence (before Compile); returns false if it is empty or too long
+		bool Add(const SequenceDefinition& definition);
+
+		// Build the automaton (StartServer)
+		void Compile();
+		bool Enabled() const { return !definitions.empty(); }
+
+		// Advance by one event; appends the event ids of completed sequences to matches
+		void Advance(SequenceState& state, uint16_t eventId, int64_t nowNs, std::vector<uint16_t>& matches) const;
+
+	private:
+		bool timingMatches(const SequenceDefinition& definition, const SequenceState& state) const;
+
+		std::vector<SequenceDefinition> definitions;
+
+		// Compiled form
+		std::vector<int> symbolOf;				// event id -> alphabet index (-1 = not in any sequence)
+		int alphabetSize;
+		std::vector<int> transitions;			// node * alphabetSize + symbol -> node
+		std::vector<std::vector<int>> outputs;	// node -> definitions ending there (incl. via failure links)
+		int64_t maxGapNs;						// longest gap any sequence allows (0 = unlimited)
+};
@@ -1,6 +1,12 @@
 #include "tourbox_server.h"
 #include "tourbox_client.h"
 #include <iostream>
+#include <cerrno>
+#include <chrono>
+
+#ifdef __linux__
+    #include <linux/net_tstamp.h>
+#endif
 
 const bool DEBUG = false; // Disable debug output for Node.js addon
 
@@ -10,12 +16,14 @@ const bool DEBUG = false; // Disable debug output for Node.js addon
  * Initializes socket to invalid state and running flag to false
  * Prepares Windows process info structures for fake Max/MSP process creation
  */
-TourBoxServerWrapper::TourBoxServerWrapper() : serverSocket(INVALID_SOCKET), running(false) 
+TourBoxServerWrapper::TourBoxServerWrapper() : boundPort(0), running(false), connectionCount(0), activeClients(0), embedded(false), rawData(false) 
 {
 #ifdef _WIN32
     ZeroMemory(&fakeMaxProcess, sizeof(fakeMaxProcess));
     ZeroMemory(&startupInfo, sizeof(startupInfo));
     startupInfo.cb = sizeof(startupInfo);
+#else
+    wakePipe[0] = wakePipe[1] = -1;
 #endif
 }
 
@@ -55,6 +63,34 @@ bool TourBoxServerWrapper::Initialize()
     return true;
 }
 
+/**
+ * Format a socket address as a numeric host string
+ * @param addr Address to format (IPv4 or IPv6)
+ * @param addrLen Size of the address structure
+ * @param port Receives the port number in host byte order (optional)
+ * @return Numeric host string, with IPv4-mapped IPv6 addresses shown as plain IPv4
+ */
+static std::string formatAddress(const sockaddr* addr, socklen_t addrLen, int* port = nullptr)
+{
+    char host[NI_MAXHOST] = {0};
+    char service[NI_MAXSERV] = {0};
+    if (getnameinfo(addr, addrLen, host, sizeof(host), service, sizeof(service), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+    {
+        if (port) *port = 0;
+        return "unknown";
+    }
+
+    if (port) *port = atoi(service);
+
+    // Dual-stack sockets report IPv4 peers as ::ffff:a.b.c.d
+    std::string result = host;
+    if (result.compare(0, 7, "::ffff:") == 0 && result.find('.') != std::string::npos)
+    {
+        result = result.substr(7);
+    }
+    return result;
+}
+
 /**
  * Start TourBox TCP Server
  * @param port Port number to listen on (default: 50500)
@@ -63,124 +99,575 @@ bool TourBoxServerWrapper::Initialize()
  */
 bool TourBoxServerWrapper::StartServer(int port, const std::string& ip) 
 {
-    if (DEBUG) std::cout << "Starting TourBox server on " << ip << ":" << port << "..." << std::endl;
+    return StartServer(port, std::vector<std::string>{ ip });
+}
 
-    // Create socket
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket == INVALID_SOCKET) 
-	{
-        if (DEBUG) std::cerr << "Failed to create socket. Error: " << SOCKET_ERROR_CODE << std::endl;		
-        return false;
-    }
+/**
+ * Start TourBox TCP Server on one or more addresses
+ * @param port Port number to listen on
+ * @param addresses Addresses or host names to bind to ("0.0.0.0", "::", "::1", "localhost", ...)
+ *                  "*" or "" binds the wildcard address of every available family
+ * @param dualStack Let IPv6 listeners also accept IPv4 peers when no IPv4 listener is bound
+ * @return true if every address was resolved and bound, false otherwise (see GetLastError)
+ *
+ * Addresses are resolved with getaddrinfo, so host names and IPv6 literals
+ * (optionally in [brackets]) are accepted. Every listener feeds the same
+ * accept loop and client pipeline.
+ */
+bool TourBoxServerWrapper::StartServer(int port, const std::vector<std::string>& addresses, bool dualStack)
+{
+    lastError.clear();
 
-    // Allow socket reuse
-    int opt = 1;
-#ifdef _WIN32
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (char*)&opt, sizeof(opt));
-#else
-    setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-#endif
+    std::vector<std::string> hosts = addresses;
+    if (hosts.empty()) hosts.push_back("127.0.0.1");
 
-    // Setup address
-    sockaddr_in serverAddr;
-	memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_port = htons(port);
-    serverAddr.sin_addr.s_addr = inet_addr(ip.c_str());
+    // Resolve everything up front so a bad address fails before anything is bound
+    std::vector<addrinfo*> resolved;
+    bool hasIPv4 = false;
+    std::string service = std::to_string(port);
+    for (std::string host : hosts)
+    {
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+        {
+            host = host.substr(1, host.size() - 2);
+        }
 
-    // Bind socket
-    if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) 
-	{
-        if (DEBUG) std::cerr << "Bind failed. Error: " << SOCKET_ERROR_CODE << std::endl;
-		closesocket(serverSocket);
-		serverSocket = INVALID_SOCKET;
-        return false;
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+        addrinfo* result = nullptr;
+        int rc = getaddrinfo((host.empty() || host == "*") ? nullptr : host.c_str(), service.c_str(), &hints, &result);
+        if (rc != 0 || !result)
+        {
+            lastError = "Cannot resolve address '" + host + "': " + gai_strerror(rc);
+            if (DEBUG) std::cerr << lastError << std::endl;
+            for (addrinfo* r : resolved) freeaddrinfo(r);
+            return false;
+        }
+
+        for (addrinfo* ai = result; ai; ai = ai->ai_next)
+        {
+            if (ai->ai_family == AF_INET) hasIPv4 = true;
+        }
+        resolved.push_back(result);
     }
 
-    // Listen for connections
-    if (listen(serverSocket, 5) == SOCKET_ERROR) 
-	{
-        if (DEBUG) std::cerr << "Listen failed. Error: " << SOCKET_ERROR_CODE << std::endl;
-		closesocket(serverSocket);
-		serverSocket = INVALID_SOCKET;		
-        return false;
+    // An IPv6 listener may only take IPv4 peers when nothing else binds IPv4
+    bool v6Only = hasIPv4 || !dualStack;
+
+    // Port 0 lets the kernel pick one port for every address; when the first pick is
+    // already taken on another address, start over with a fresh one a few times
+    const int kMaxEphemeralAttempts = 8;
+    for (int attempt = 1; ; attempt++)
+    {
+        bool portTaken = false;
+        if (bindListeners(hosts, resolved, port, v6Only, portTaken)) break;
+        if (!portTaken || attempt >= kMaxEphemeralAttempts)
+        {
+            if (portTaken) lastError = "No ephemeral port is free on every address (" + lastError + ")";
+            for (addrinfo* r : resolved) freeaddrinfo(r);
+            return false;
+        }
+        if (DEBUG) std::cout << "Ephemeral port in use on another address, retrying (" << lastError << ")" << std::endl;
     }
 
-    if (DEBUG) std::cout << "Server listening on " << ip << ":" << port << std::endl;
+    for (addrinfo* r : resolved) freeaddrinfo(r);
+    lastError.clear();
+
+    // Report the port the kernel actually bound rather than the one requested
+    boundPort = boundAddresses.empty() ? port : boundAddresses.front().port;
+
+    if (DEBUG) std::cout << "Server listening on " << serverSockets.size() << " socket(s), port " << boundPort << std::endl;
     if (DEBUG) std::cout << "TourBox Console should connect automatically!" << std::endl;
 
     running = true;
+    sequences.Compile();
+    dispatcher.SetWaiters(&waiters);
+    dispatcher.SetStreams(&streams);
+
+    // The owner's event loop accepts and reads; events are delivered on its thread as they decode
+    if (embedded)
+    {
+        for (socket_t listener : serverSockets)
+        {
+            setNonBlocking(listener);
+        }
+        dispatcher.StartInline();
+        return true;
+    }
+
+    // Start the delivery stage before any client can produce events
+    dispatcher.Start(threadOptions.dispatch, threadOptions.namePrefix + "-dispatch");
+    sampler.SetProfiles(&profiles);
+    sampler.Start(threadOptions.dispatch, threadOptions.namePrefix + "-sample");
+
+    // Gestures and repeats are events too, so sampling mode (which replaces events) leaves them off
+    if ((gestures.Enabled() || repeater.Enabled()) && !sampler.Enabled())
+    {
+        bool stamp = clientSocketOptions.rxTimestamps != RxTimestampMode::Off;
+        timers.Start(threadOptions.dispatch, threadOptions.namePrefix + "-timer");
+        gestures.Start(stamp);
+        repeater.Start(stamp);
+    }
     
+#ifndef _WIN32
+    // Without the pipe the accept loop falls back to polling running with a select() timeout
+    if (pipe(wakePipe) != 0)
+    {
+        if (DEBUG) std::cerr << "pipe() failed. Error: " << errno << std::endl;
+        wakePipe[0] = wakePipe[1] = -1;
+    }
+#endif
+
     // Start server thread
     serverThread = std::thread(&TourBoxServerWrapper::Run, this);
     
     return true;
 }
 
+/**
+ * Bind Every Resolved Address
+ * @param hosts Addresses as given, for error messages
+ * @param resolved getaddrinfo results, one list per host (ports are rewritten)
+ * @param port Requested port; 0 binds the first listener to an ephemeral port
+ *             and every further one to that same port
+ * @param v6Only IPV6_V6ONLY for IPv6 listeners
+ * @param portTaken Set when the ephemeral port turned out to be in use on a
+ *                  later address, so a retry with a fresh port may succeed
+ * @return true if every host got at least one listener; on failure nothing
+ *         stays bound and lastError says why
+ */
+bool TourBoxServerWrapper::bindListeners(const std::vector<std::string>& hosts, const std::vector<addrinfo*>& resolved,
+                                         int port, bool v6Only, bool& portTaken)
+{
+    int ephemeralPort = 0;
+    boundAddresses.clear();
+
+    for (size_t i = 0; i < resolved.size(); i++)
+    {
+        bool boundAny = false;
+        for (addrinfo* ai = resolved[i]; ai; ai = ai->ai_next)
+        {
+            // Reset on every attempt, a previous one may have set the old ephemeral port
+            uint16_t bindPort = htons((uint16_t)(ephemeralPort ? ephemeralPort : port));
+            if (ai->ai_family == AF_INET) ((sockaddr_in*)ai->ai_addr)->sin_port = bindPort;
+            else if (ai->ai_family == AF_INET6) ((sockaddr_in6*)ai->ai_addr)->sin6_port = bindPort;
+
+            int error = 0;
+            socket_t listener = openListener(ai, v6Only, error);
+            if (listener == INVALID_SOCKET)
+            {
+                if (ephemeralPort && error == SOCKET_ADDRESS_IN_USE)
+                {
+                    portTaken = true;
+                    closeListeners();
+                    return false;
+                }
+                continue;
+            }
+
+            serverSockets.push_back(listener);
+            boundAny = true;
+
+            // Read back what was bound; this is the only source of the port when 0 was requested
+            sockaddr_storage boundAddr;
+            socklen_t boundAddrSize = sizeof(boundAddr);
+            if (getsockname(listener, (sockaddr*)&boundAddr, &boundAddrSize) == 0)
+            {
+                ListenAddress bound;
+                bound.family = boundAddr.ss_family == AF_INET6 ? 6 : 4;
+                bound.address = formatAddress((sockaddr*)&boundAddr, boundAddrSize, &bound.port);
+                boundAddresses.push_back(bound);
+                if (port == 0 && !ephemeralPort) ephemeralPort = bound.port;
+            }
+        }
+
+        if (!boundAny)
+        {
+            lastError = "Failed to listen on " + hosts[i] + ":" + std::to_string(ephemeralPort ? ephemeralPort : port) + " (" + lastError + ")";
+            if (DEBUG) std::cerr << lastError << std::endl;
+            closeListeners();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Create, bind and listen on a single resolved address
+ * @param ai Resolved address to listen on
+ * @param v6Only Value for IPV6_V6ONLY on IPv6 sockets
+ * @param error Receives the socket error code on failure
+ * @return Listening socket, or INVALID_SOCKET with lastError set
+ */
+socket_t TourBoxServerWrapper::openListener(const addrinfo* ai, bool v6Only, int& error)
+{
+    std::string where = formatAddress(ai->ai_addr, (socklen_t)ai->ai_addrlen);
+
+    // Create socket
+    socket_t listener = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (listener == INVALID_SOCKET) 
+    {
+        error = SOCKET_ERROR_CODE;
+        lastError = "socket() failed for " + where + ", error " + std::to_string(error);
+        if (DEBUG) std::cerr << lastError << std::endl;
+        return INVALID_SOCKET;
+    }
+
+    // Allow socket reuse
+    int opt = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&opt, sizeof(opt));
+
+    if (ai->ai_family == AF_INET6)
+    {
+        int v6 = v6Only ? 1 : 0;
+        setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&v6, sizeof(v6));
+    }
+
+    // Bind socket
+    if (bind(listener, ai->ai_addr, (socklen_t)ai->ai_addrlen) == SOCKET_ERROR) 
+    {
+        error = SOCKET_ERROR_CODE;
+        lastError = "bind() failed for " + where + ", error " + std::to_string(error);
+        if (DEBUG) std::cerr << lastError << std::endl;
+        CLOSE_SOCKET(listener);
+        return INVALID_SOCKET;
+    }
+
+    // Listen for connections
+    if (listen(listener, 5) == SOCKET_ERROR) 
+    {
+        error = SOCKET_ERROR_CODE;
+        lastError = "listen() failed for " + where + ", error " + std::to_string(error);
+        if (DEBUG) std::cerr << lastError << std::endl;
+        CLOSE_SOCKET(listener);
+        return INVALID_SOCKET;
+    }
+
+    if (DEBUG) std::cout << "Listening on " << where << (ai->ai_family == AF_INET6 && !v6Only ? " (dual-stack)" : "") << std::endl;
+    return listener;
+}
+
 /**
  * Main Server Loop - Accept and Handle Client Connections
  * Runs in a separate thread to handle incoming TourBox device connections
+ * Waits on every listening socket at once so IPv4 and IPv6 clients share one pipeline
  */
 void TourBoxServerWrapper::Run() 
 {
+    ApplyThreadPlacement(threadOptions.accept, threadOptions.namePrefix + "-accept");
+
+    // Consecutive select() failures before the accept loop gives up (about a second of back-off)
+    const int kMaxSelectErrors = 100;
+    int selectErrors = 0;
+
     while (running) 
     {
-        sockaddr_in clientAddr;
-#ifdef _WIN32
-        int clientAddrSize = sizeof(clientAddr);
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        socket_t maxSocket = 0;
+        for (socket_t listener : serverSockets)
+        {
+            FD_SET(listener, &readSet);
+            if (listener > maxSocket) maxSocket = listener;
+        }
+
+        // Stop() wakes the loop through the pipe; without one, re-check running periodically
+        timeval pollInterval = { 0, 100000 };
+        timeval* timeout = &pollInterval;
+#ifndef _WIN32
+        if (wakePipe[0] >= 0)
+        {
+            FD_SET(wakePipe[0], &readSet);
+            if (wakePipe[0] > maxSocket) maxSocket = wakePipe[0];
+            timeout = nullptr;
+        }
 #else
-        socklen_t clientAddrSize = sizeof(clientAddr);
+        timeout = nullptr;
 #endif
-        socket_t clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientAddrSize);
-        if (clientSocket == INVALID_SOCKET) 
+
+        int ready = select((int)maxSocket + 1, &readSet, nullptr, nullptr, timeout);
+        if (!running) break;
+        if (ready < 0)
         {
-            if (running && DEBUG) 
+#ifndef _WIN32
+            if (errno == EINTR) continue;
+#endif
+            if (DEBUG) std::cerr << "Select failed. Error: " << SOCKET_ERROR_CODE << std::endl;
+
+            // Back off instead of spinning, and stop accepting if the error persists
+            if (++selectErrors >= kMaxSelectErrors)
             {
-                std::cerr << "Accept failed. Error: " << SOCKET_ERROR_CODE << std::endl;
+                if (DEBUG) std::cerr << "Accept loop stopped after repeated select() failures" << std::endl;
+                break;
             }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
             continue;
         }
+        selectErrors = 0;
+        if (ready == 0) continue;
+
+        for (socket_t listener : serverSockets)
+        {
+            if (!running) break;
+            if (!FD_ISSET(listener, &readSet)) continue;
+
+            sockaddr_storage clientAddr;
+#ifdef _WIN32
+            int clientAddrSize = sizeof(clientAddr);
+#else
+            socklen_t clientAddrSize = sizeof(clientAddr);
+#endif
+            socket_t clientSocket = accept(listener, (sockaddr*)&clientAddr, &clientAddrSize);
+            if (clientSocket == INVALID_SOCKET) 
+            {
+                if (running && DEBUG) 
+                {
+                    std::cerr << "Accept failed. Error: " << SOCKET_ERROR_CODE << std::endl;
+                }
+                continue;
+            }
+
+            int clientPort = 0;
+            std::string clientIP = formatAddress((sockaddr*)&clientAddr, (socklen_t)clientAddrSize, &clientPort);
+
+            if (DEBUG) std::cout << "TourBox Console connected!" << std::endl;
+            if (DEBUG) std::cout << "Connection from: " << clientIP << ":" << clientPort << std::endl;
+
+            applyClientSocketOptions(clientSocket);
+
+            // Emit connection event to Node.js
+            EmitConnectionEvent(Owner(), "connect", clientIP, clientPort);
+
+            {
+                std::lock_guard<std::mutex> g(clientsMutex);
+                clientSockets.insert(clientSocket);
+                activeClients++;
+            }
+
+            // Create and run client in a separate thread
+            std::string threadName = threadOptions.namePrefix + "-io-" + std::to_string(++connectionCount);
+            std::thread clientThread([this, clientSocket, clientIP, clientPort, threadName]() 
+            {
+                ApplyThreadPlacement(threadOptions.io, threadName);
+                {
+                    TourBoxClientWrapper client(clientSocket, this);
+                    client.Run();
+
+                    // Forget the socket before the client closes it, so Stop() never touches a reused descriptor
+                    std::lock_guard<std::mutex> g(clientsMutex);
+                    clientSockets.erase(clientSocket);
+                }
 
-        if (DEBUG) std::cout << "TourBox Console connected!" << std::endl;
-        if (DEBUG) std::cout << "Connection from: " << inet_ntoa(clientAddr.sin_addr) 
-                  << ":" << ntohs(clientAddr.sin_port) << std::endl;
+                // Emit disconnect event when client stops (its events have all been delivered by now)
+                EmitConnectionEvent(Owner(), "disconnect", clientIP, clientPort);
 
-        // Emit connection event to Node.js
-        std::string clientIP = inet_ntoa(clientAddr.sin_addr);
-        int clientPort = ntohs(clientAddr.sin_port);
-        EmitConnectionEvent("connect", clientIP, clientPort);
+                std::lock_guard<std::mutex> g(clientsMutex);
+                activeClients--;
+                clientsDone.notify_all();
+            });
+            clientThread.detach();
+        }
+    }
+}
 
-        // Create and run client in a separate thread
-        std::thread clientThread([this, clientSocket, clientIP, clientPort]() 
+/**
+ * Accept a Client in Embedded Mode
+ * @param listener Listening socket the event loop reported readable
+ * @param ip Receives the peer address
+ * @param port Receives the peer port
+ * @return New client on a non-blocking socket, owned by the caller; nullptr if none was pending
+ */
+TourBoxClientWrapper* TourBoxServerWrapper::AcceptClient(socket_t listener, std::string& ip, int& port)
+{
+    sockaddr_storage clientAddr;
+#ifdef _WIN32
+    int clientAddrSize = sizeof(clientAddr);
+#else
+    socklen_t clientAddrSize = sizeof(clientAddr);
+#endif
+    socket_t clientSocket = accept(listener, (sockaddr*)&clientAddr, &clientAddrSize);
+    if (clientSocket == INVALID_SOCKET)
+    {
+        if (DEBUG) std::cerr << "Accept failed. Error: " << SOCKET_ERROR_CODE << std::endl;
+        return nullptr;
+    }
+
+    ip = formatAddress((sockaddr*)&clientAddr, (socklen_t)clientAddrSize, &port);
+    if (DEBUG) std::cout << "Connection from: " << ip << ":" << port << " (embedded)" << std::endl;
+
+    applyClientSocketOptions(clientSocket);
+    setNonBlocking(clientSocket);
+    return new TourBoxClientWrapper(clientSocket, this);
+}
+
+/**
+ * Switch a socket to non-blocking mode (embedded mode)
+ */
+void TourBoxServerWrapper::setNonBlocking(socket_t socket)
+{
+#ifdef _WIN32
+    u_long on = 1;
+    ioctlsocket(socket, FIONBIO, &on);
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags != -1) fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+/**
+ * Apply the configured low-latency options to an accepted client socket
+ * @param clientSocket Newly accepted connection
+ *
+ * Each option is independent; options the platform does not support or the
+ * process is not permitted to set are skipped (reported in debug output only).
+ */
+void TourBoxServerWrapper::applyClientSocketOptions(socket_t clientSocket)
+{
+    const ClientSocketOptions& o = clientSocketOptions;
+    auto set = [clientSocket](int level, int name, int value, const char* label)
+    {
+        if (setsockopt(clientSocket, level, name, (const char*)&value, sizeof(value)) == SOCKET_ERROR)
         {
-            TourBoxClientWrapper client(clientSocket, this);
-            client.Run();
-            // Emit disconnect event when client stops
-            EmitConnectionEvent("disconnect", clientIP, clientPort);
-        });
-        clientThread.detach();
+            if (DEBUG) std::cerr << "Failed to set " << label << ". Error: " << SOCKET_ERROR_CODE << std::endl;
+        }
+    };
+
+    if (o.noDelay) set(IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    if (o.rcvBufBytes > 0) set(SOL_SOCKET, SO_RCVBUF, o.rcvBufBytes, "SO_RCVBUF");
+#ifndef _WIN32
+    // Winsock does not allow SO_RCVLOWAT to be changed
+    if (o.rcvLowat > 0) set(SOL_SOCKET, SO_RCVLOWAT, o.rcvLowat, "SO_RCVLOWAT");
+#endif
+#ifdef TCP_QUICKACK
+    if (o.quickAck) set(IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+#ifdef SO_BUSY_POLL
+    if (o.busyPollUs > 0) set(SOL_SOCKET, SO_BUSY_POLL, o.busyPollUs, "SO_BUSY_POLL");
+#endif
+#ifdef __linux__
+    if (o.rxTimestamps == RxTimestampMode::TimestampNs)
+    {
+        set(SOL_SOCKET, SO_TIMESTAMPNS, 1, "SO_TIMESTAMPNS");
     }
+    else if (o.rxTimestamps == RxTimestampMode::Timestamping)
+    {
+        // Software stamps only: hardware stamps are in the NIC's clock, not Unix time
+        set(SOL_SOCKET, SO_TIMESTAMPING, SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE, "SO_TIMESTAMPING");
+    }
+#endif
 }
 
 /**
  * Stop Server and Clean Shutdown
  * Initiates graceful shutdown sequence for the TourBox server
+ * The accept loop is woken through its pipe (Winsock: by closing the listeners),
+ * and the listeners are only closed once it has exited
  */
 void TourBoxServerWrapper::Stop() 
 {
     if (DEBUG) std::cout << "Stopping TourBox server..." << std::endl;
     running = false;
+
+#ifdef _WIN32
+    // Winsock only wakes select() when the socket is closed
+    for (socket_t listener : serverSockets)
+    {
+        CLOSE_SOCKET(listener);
+    }
     
-    if (serverSocket != INVALID_SOCKET) 
+    if (serverThread.joinable()) 
 	{
-        CLOSE_SOCKET(serverSocket);
-        serverSocket = INVALID_SOCKET;
+        serverThread.join();
     }
-    
+
+    serverSockets.clear();
+    stopClients();
+#else
+    // A byte in the pipe wakes select() on every platform, which shutdown() of a listener does not
+    if (wakePipe[1] >= 0)
+    {
+        char wake = 1;
+        if (write(wakePipe[1], &wake, 1) < 0 && DEBUG) std::cerr << "Wake-up write failed. Error: " << errno << std::endl;
+    }
+
     if (serverThread.joinable()) 
 	{
         serverThread.join();
     }
+
+    for (int& fd : wakePipe)
+    {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    closeListeners();
+    stopClients();
+#endif
+
+    // Timers first: the timer thread is the producer of the gesture and repeat sources
+    timers.Stop();
+    gestures.Stop();
+    repeater.Stop();
+    sampler.Stop();
+    dispatcher.Stop();
+
+    // Nothing can match, time out or arrive any more; the addon settles what is left
+    waiters.Clear();
+    streams.CloseAll();
+}
+
+/**
+ * Disconnect All Clients
+ * Shuts down every client socket and waits for the client threads to finish,
+ * so no client outlives the server or pushes into a stopped dispatcher
+ */
+void TourBoxServerWrapper::stopClients()
+{
+    std::unique_lock<std::mutex> lock(clientsMutex);
+    for (socket_t clientSocket : clientSockets)
+    {
+        shutdown(clientSocket, SHUTDOWN_BOTH);
+    }
+    clientsDone.wait(lock, [this]() { return activeClients == 0; });
+}
+
+/**
+ * Close all listening sockets
+ */
+void TourBoxServerWrapper::closeListeners()
+{
+    for (socket_t listener : serverSockets)
+    {
+        CLOSE_SOCKET(listener);
+    }
+    serverSockets.clear();
+}
+
+/**
+ * Register a Waiter
+ * @param waiterId Id reported back through DeliverWaiterResults
+ * @param eventId Event that resolves it
+ * @param timeoutMs Timeout in milliseconds (<= 0 = none)
+ * @return false if the server is not running
+ *
+ * Timeouts need the timer thread, which otherwise only runs for gestures
+ * and auto-repeat, so the first waiter with a timeout starts it.
+ */
+bool TourBoxServerWrapper::AddWaiter(uint64_t waiterId, uint16_t eventId, int64_t timeoutMs)
+{
+    if (!running) return false;
+
+    if (timeoutMs > 0 && !timers.IsRunning())
+    {
+        timers.Start(threadOptions.dispatch, threadOptions.namePrefix + "-timer");
+    }
+    return waiters.Add(waiterId, eventId, timeoutMs);
 }
 
 /**
@@ -201,11 +688,27 @@ void TourBoxServerWrapper::Cleanup()
 #endif
 }
 
+/**
+ * Set Owner Id - Tags Everything This Server Delivers
+ * @param id Server id the addon looks the callbacks up by
+ */
+void TourBoxServerWrapper::SetOwner(int id)
+{
+    dispatcher.SetOwner(id);
+    sampler.SetOwner(id);
+    waiters.SetOwner(id);
+    streams.SetOwner(id);
+}
+
 // Thread-safe button state accessors
 void TourBoxServerWrapper::SetButtonHeld(int code, bool held)
 {
-    std::lock_guard<std::mutex> g(buttonStatesMutex);
-    buttonStates[code] = held;
+    {
+        std::lock_guard<std::mutex> g(buttonStatesMutex);
+        buttonStates[code] = held;
+    }
+    if (sampler.Enabled()) sampler.SetHeld(code, held);
+    repeater.SetHeld(code, held);
 }
 
 bool TourBoxServerWrapper::IsButtonHeld(int code)
@@ -1,10 +1,26 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <map>
 #include <memory>
+#include <set>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "tourbox_thread.h"
+#include "tourbox_dispatcher.h"
+#include "tourbox_velocity.h"
+#include "tourbox_encoders.h"
+#include "tourbox_sampler.h"
+#include "tourbox_timer.h"
+#include "tourbox_gestures.h"
+#include "tourbox_repeat.h"
+#include "tourbox_layers.h"
+#include "tourbox_sequences.h"
+#include "tourbox_profile.h"
 
 #ifdef _WIN32
     #include <winsock2.h>
@@ -13,34 +29,109 @@
     #pragma comment(lib, "ws2_32.lib")
     typedef SOCKET socket_t;
     #define CLOSE_SOCKET closesocket
+    #define SHUTDOWN_BOTH SD_BOTH
     #define SOCKET_ERROR_CODE WSAGetLastError()
+    #define SOCKET_ADDRESS_IN_USE WSAEADDRINUSE
 #else
     #include <sys/socket.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <arpa/inet.h>
+    #include <netdb.h>
+    #include <sys/select.h>
+    #include <sys/time.h>
     #include <unistd.h>
+    #include <fcntl.h>
     #include <cstring>
     typedef int socket_t;
     #define INVALID_SOCKET -1
     #define SOCKET_ERROR -1
     #define CLOSE_SOCKET close
+    #define SHUTDOWN_BOTH SHUT_RDWR
     #define SOCKET_ERROR_CODE errno
+    #define SOCKET_ADDRESS_IN_USE EADDRINUSE
 #endif
 
 // Forward declarations
 class TourBoxClientWrapper;
 
-// Function to emit events to Node.js (defined in tourbox_addon.cc)
-extern void EmitToNode(const std::string& eventName, int count);
-extern void EmitRawData(const char* buffer, int length);
-extern void EmitConnectionEvent(const std::string& eventType, const std::string& ip, int port);
+// Functions to emit events of server owner to Node.js (defined in tourbox_addon.cc)
+// Control events and raw data are delivered through the dispatcher, see DeliverEvents()
+extern void EmitConnectionEvent(int owner, const std::string& eventType, const std::string& ip, int port);
+
+// Source of the receive timestamp attached to decoded events
+enum class RxTimestampMode
+{
+	Off,			// no timestamp
+	TimestampNs,	// SO_TIMESTAMPNS (Linux)
+	Timestamping	// SO_TIMESTAMPING software receive stamp (Linux)
+};
+
+// Per-connection socket options applied when a TourBox client is accepted.
+// Zero / false leaves the kernel default in place.
+struct ClientSocketOptions
+{
+	bool noDelay = false;		// TCP_NODELAY
+	bool quickAck = false;		// TCP_QUICKACK (Linux, re-armed after every recv)
+	int rcvLowat = 0;			// SO_RCVLOWAT in bytes
+	int busyPollUs = 0;			// SO_BUSY_POLL budget in microseconds (Linux)
+	int rcvBufBytes = 0;		// SO_RCVBUF in bytes
+	RxTimestampMode rxTimestamps = RxTimestampMode::Off;	// read with recvmsg() and stamp events
+
+	// Lowest input-to-event latency at the cost of CPU
+	static ClientSocketOptions LowLatency()
+	{
+		ClientSocketOptions o;
+		o.noDelay = true;
+		o.quickAck = true;
+		o.rcvLowat = 1;
+		o.busyPollUs = 50;
+		return o;
+	}
+};
+
+// How TourBoxClientWrapper turns the byte stream into events
+struct DecoderOptions
+{
+	// Keep a run of identical rotation bytes open across recv() calls until a
+	// different byte arrives or the stream has been idle this long (0 = flush
+	// at the end of every packet)
+	int idleFlushMs = 0;
+	// Longest a held run may stay open while data keeps arriving, so a continuous
+	// spin is still reported at least this often (only used with idleFlushMs)
+	int maxHoldMs = 16;
+};
+
+// One bound listener as reported by getsockname()
+struct ListenAddress
+{
+	std::string address;	// numeric host
+	int port;
+	int family;				// 4 or 6
+};
 
 class TourBoxServerWrapper 
 {
 	private:
-		socket_t serverSocket;
+		// One listening socket per bound address (IPv4 and/or IPv6)
+		std::vector<socket_t> serverSockets;
+		std::vector<ListenAddress> boundAddresses;
+		int boundPort;
 		std::atomic<bool> running;
 		std::thread serverThread;
+		std::string lastError;
+		std::atomic<int> connectionCount;
+
+	#ifndef _WIN32
+		// Self-pipe that wakes the accept loop on Stop(); shutdown() of a listener does not wake select() on BSD / macOS
+		int wakePipe[2];
+	#endif
+
+		// Live client connections, shut down and waited for by Stop()
+		std::set<socket_t> clientSockets;
+		int activeClients;
+		std::mutex clientsMutex;
+		std::condition_variable clientsDone;
 
 	#ifdef _WIN32
 		PROCESS_INFORMATION fakeMaxProcess;
@@ -54,19 +145,95 @@ class TourBoxServerWrapper
 		// Mutex to protect buttonStates (accessed from multiple threads)
 		std::mutex buttonStatesMutex;
 
+		// Options applied to every accepted client socket (set before StartServer)
+		ClientSocketOptions clientSocketOptions;
+
+		// Byte stream decoding options for every client (set before StartServer)
+		DecoderOptions decoderOptions;
+
+		// Velocity-based scaling of rotation deltas (set before StartServer)
+		AccelerationOptions accelerationOptions;
+
+		// Virtual absolute encoders driven by the rotation controls (define before StartServer)
+		EncoderBank encoders;
+
+		// Fixed-rate state sampling; when enabled it replaces per-event delivery (rate set before StartServer)
+		StateSampler sampler;
+
+		// Shared timer thread and the tap / double-tap / long-press detection it drives (configure before StartServer)
+		TimerWheel timers;
+		GestureEngine gestures{timers, dispatcher};
+		AutoRepeater repeater{timers, dispatcher};
+
+		// Pending waitFor() requests, resolved by the next matching event (timeouts on the timer thread)
+		WaiterRegistry waiters{timers};
+
+		// Async-iterator event streams, each with its own pull-driven queue
+		EventStreams streams;
+
+		// Mapping layers switched by trigger buttons (define before StartServer)
+		ControlLayers layers;
+
+		// Byte-to-control mapping used to decode; Publish swaps it while clients stay connected
+		ProfileTable profiles{DeviceProfile::Builtin()};
+
+		// Multi-step shortcuts (add before StartServer, which compiles them)
+		SequenceMatcher sequences;
+
+		// CPU / scheduling placement of the accept and client threads (set before StartServer)
+		ThreadOptions threadOptions;
+
+		// Embedded mode: no server threads. The owner polls Listeners() and the sockets of the clients
+		// it accepts on its own (JavaScript) event loop, and events are delivered inline (set before StartServer)
+		bool embedded;
+
+		// Queue every received packet as a Raw event for the raw data callback (set before StartServer)
+		bool rawData;
+
+		// Delivers decoded events from all client threads to Node.js
+		TourBoxDispatcher dispatcher;
+
+		// Server id handed back with everything delivered to Node.js, so each server reaches its own callbacks (set before StartServer)
+		void SetOwner(int id);
+		int Owner() const { return dispatcher.Owner(); }
+
 		// Thread-safe accessors
 		void SetButtonHeld(int code, bool held);
 		bool IsButtonHeld(int code);
 
+		// Resolve waiterId with the next eventId event (timeoutMs <= 0 = no timeout); false if not running
+		bool AddWaiter(uint64_t waiterId, uint16_t eventId, int64_t timeoutMs);
+
 		TourBoxServerWrapper();
 		~TourBoxServerWrapper();
 
 		bool Initialize();
 		bool StartServer(int port = 50500, const std::string& ip = "127.0.0.1");
+		bool StartServer(int port, const std::vector<std::string>& addresses, bool dualStack = true);
 		void Run();
 		void Stop();
 		void Cleanup();
 
+		// Embedded mode: listening sockets to poll, and accepting a client on one that is readable
+		// (nullptr if nothing was pending); the caller owns the client and drives it with Begin / Poll / Finish
+		const std::vector<socket_t>& Listeners() const { return serverSockets; }
+		TourBoxClientWrapper* AcceptClient(socket_t listener, std::string& ip, int& port);
+
+		// Human readable reason for the last StartServer failure
+		const std::string& GetLastError() const { return lastError; }
+
+		// Port the listeners are bound to, read back with getsockname() (0 until started).
+		// StartServer with port 0 binds an ephemeral port, the same one on every address.
+		int GetPort() const { return boundPort; }
+		const std::vector<ListenAddress>& GetAddresses() const { return boundAddresses; }
+
 	private:
 		//bool createFakeMaxProcess();
+		bool bindListeners(const std::vector<std::string>& hosts, const std::vector<addrinfo*>& resolved,
+		                   int port, bool v6Only, bool& portTaken);
+		socket_t openListener(const addrinfo* ai, bool v6Only, int& error);
+		void applyClientSocketOptions(socket_t clientSocket);
+		static void setNonBlocking(socket_t socket);
+		void stopClients();
+		void closeListeners();
 };
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "tourbox_streams.h"
+#include <algorithm>
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+static std::atomic<uint64_t> g_nextStreamId(1);
+
+/**
+ * Constructor - No Streams
+ */
+EventStreams::EventStreams() : owner(0), open(0)
+{
+}
+
+/**
+ * Open a Stream
+ * @param eventIds Events the stream receives; empty for all of them
+ * @param batchSize Most events handed over per pull (0 = 64)
+ * @return Stream id
+ */
+uint64_t EventStreams::Open(const std::vector<uint16_t>& eventIds, size_t batchSize)
+{
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->all = eventIds.empty();
+    stream->wanted.assign(kMaxEventIds, false);
+    for (uint16_t id : eventIds)
+    {
+        if (id < kMaxEventIds) stream->wanted[id] = true;
+    }
+    stream->batchSize = batchSize ? batchSize : 64;
+    stream->taken = 0;
+    stream->waiting = false;
+    stream->dropped = 0;
+
+    uint64_t id = stream->id = g_nextStreamId.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> g(mutex);
+    streams.push_back(std::move(stream));
+    open.store((int)streams.size(), std::memory_order_relaxed);
+    return id;
+}
+
+/**
+ * Close a Stream
+ * @param streamId Stream to drop, with whatever it still queued
+ */
+void EventStreams::Close(uint64_t streamId)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    streams.erase(std::remove_if(streams.begin(), streams.end(),
+                                 [streamId](const std::unique_ptr<Stream>& s) { return s->id == streamId; }),
+                  streams.end());
+    open.store((int)streams.size(), std::memory_order_relaxed);
+}
+
+/**
+ * Close Every Stream (server stopping)
+ */
+void EventStreams::CloseAll()
+{
+    std::lock_guard<std::mutex> g(mutex);
+    streams.clear();
+    open.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * Pull the Next Batch
+ * @param streamId Stream being iterated
+ * @param out Receives the batch when the result is Ready
+ * @return Ready, Waiting (the next offered event is delivered instead) or Closed
+ */
+EventStreams::PullResult EventStreams::Pull(uint64_t streamId, StreamBatch& out)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    for (auto& stream : streams)
+    {
+        if (stream->id != streamId) continue;
+
+        if (stream->queue.empty())
+        {
+            stream->waiting = true;
+            return Waiting;
+        }
+        take(*stream, out);
+        return Ready;
+    }
+    return Closed;
+}
+
+/**
+ * Queue an Event on Every Stream That Wants It
+ * @param ev Decoded event
+ *
+ * A rotation is merged into the queued entry of the same control wherever
+ * it sits, so a consumer that falls behind gets one larger step per control
+ * rather than a growing backlog, and rotations alone can never fill the
+ * queue. Only when transitions have filled it is an event dropped (and
+ * counted). When a pull is pending the queue goes out at once; otherwise it
+ * waits for the next pull.
+ */
+void EventStreams::offer(const TourBoxEvent& ev)
+{
+    std::vector<StreamBatch*> ready;
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        for (auto& stream : streams)
+        {
+            if (!stream->all && !(ev.id < kMaxEventIds && stream->wanted[ev.id])) continue;
+
+            auto pending = ev.kind == EventKind::Rotation ? stream->rotations.find(ev.id) : stream->rotations.end();
+            if (pending != stream->rotations.end())
+            {
+                TourBoxEvent& queued = stream->queue[pending->second - stream->taken];
+                if (ev.hasValue || queued.hasValue)
+                {
+                    double before = queued.hasValue ? queued.value : (double)queued.direction * queued.count;
+                    double added = ev.hasValue ? ev.value : (double)ev.direction * ev.count;
+                    queued.value = before + added;
+                    queued.hasValue = true;
+                }
+                queued.count += ev.count;
+            }
+            else if (stream->queue.size() < kMaxStreamQueue)
+            {
+                if (ev.kind == EventKind::Rotation) stream->rotations[ev.id] = stream->taken + stream->queue.size();
+                stream->queue.push_back(ev);
+                stream->queue.back().raw = nullptr;
+            }
+            else
+            {
+                stream->dropped++;
+            }
+
+            if (stream->waiting)
+            {
+                StreamBatch* batch = new StreamBatch();
+                take(*stream, *batch);
+                stream->waiting = false;
+                ready.push_back(batch);
+            }
+        }
+    }
+
+    for (StreamBatch* batch : ready)
+    {
+        if (DEBUG) std::cout << "Stream " << batch->streamId << ": " << batch->events.size() << " event(s)" << std::endl;
+        DeliverStreamBatch(owner, batch);
+    }
+}
+
+/**
+ * Move Up to One Batch Out of a Stream's Queue
+ */
+void EventStreams::take(Stream& stream, StreamBatch& out)
+{
+    size_t n = std::min(stream.batchSize, stream.queue.size());
+    out.streamId = stream.id;
+    out.events.assign(stream.queue.begin(), stream.queue.begin() + n);
+    out.dropped = stream.dropped;
+    stream.queue.erase(stream.queue.begin(), stream.queue.begin() + n);
+    stream.taken += n;
+    stream.dropped = 0;
+
+    // Rotations handed over start a new entry next time
+    for (auto it = stream.rotations.begin(); it != stream.rotations.end();)
+    {
+        if (it->second < stream.taken) it = stream.rotations.erase(it);
+        else ++it;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "tourbox_events.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Events taken from one stream for one pull
+struct StreamBatch
+{
+	uint64_t streamId;
+	std::vector<TourBoxEvent> events;
+	uint32_t dropped;					// events lost to a full queue since the previous batch
+};
+
+// Hand a batch of server owner to the stream's pending pull in Node.js, taking ownership (defined in tourbox_addon.cc)
+extern void DeliverStreamBatch(int owner, StreamBatch* batch);
+
+// Most events a stream queues while its consumer is not pulling. Rotations never count against
+// it beyond one entry per control, so only press / release transitions can fill it.
+const size_t kMaxStreamQueue = 4096;
+
+// Pull-driven event streams (async iterators in JavaScript). Each stream has its own queue:
+// nothing is sent to Node.js until the consumer asks for the next batch, at most one batch is
+// ever in flight, and while the consumer lags the steps of a rotation are merged into its one
+// queued entry.
+class EventStreams
+{
+	public:
+		enum PullResult { Ready, Waiting, Closed };
+
+		EventStreams();
+
+		// Open a stream for these event ids (empty = every event); batchSize caps the events per pull.
+		// Ids are unique across servers, so the addon can key pending pulls by id alone.
+		uint64_t Open(const std::vector<uint16_t>& eventIds, size_t batchSize);
+		void Close(uint64_t streamId);
+		void CloseAll();
+
+		// Server id passed to DeliverStreamBatch; set before Start
+		void SetOwner(int id) { owner = id; }
+
+		// JavaScript thread: take a batch if events are queued (Ready), otherwise arm delivery
+		// of the next event through DeliverStreamBatch (Waiting)
+		PullResult Pull(uint64_t streamId, StreamBatch& out);
+
+		// Producers (any thread)
+		void Offer(const TourBoxEvent& ev)
+		{
+			if (open.load(std::memory_order_relaxed) == 0) return;
+			offer(ev);
+		}
+
+	private:
+		struct Stream
+		{
+			uint64_t id;
+			bool all;
+			std::vector<bool> wanted;		// by event id
+			size_t batchSize;
+			std::deque<TourBoxEvent> queue;
+			uint64_t taken;					// events taken off the front so far, turns positions into indexes
+			std::map<uint16_t, uint64_t> rotations;	// queued rotation entry by event id (position = taken + index)
+			bool waiting;					// a pull is pending in JavaScript
+			uint32_t dropped;
+		};
+
+		void offer(const TourBoxEvent& ev);
+		static void take(Stream& stream, StreamBatch& out);
+
+		int owner;
+		std::atomic<int> open;
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Stream>> streams;
+};
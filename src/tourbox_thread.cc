@@ -0,0 +1,150 @@
+#include "tourbox_thread.h"
+#include <iostream>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/resource.h>
+    #include <cerrno>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+        #include <unistd.h>
+    #endif
+#endif
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+#ifdef _WIN32
+typedef HRESULT (WINAPI *SetThreadDescriptionFn)(HANDLE, PCWSTR);
+
+/**
+ * Map a POSIX-style request onto a Win32 thread priority
+ * Real-time policies use the top of the range, nice values the normal bands
+ */
+static int windowsPriority(const ThreadPlacement& placement)
+{
+    if (placement.policy != ThreadPolicy::Default)
+    {
+        return placement.priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    }
+    if (placement.nice <= -10) return THREAD_PRIORITY_HIGHEST;
+    if (placement.nice < 0)    return THREAD_PRIORITY_ABOVE_NORMAL;
+    if (placement.nice >= 10)  return THREAD_PRIORITY_LOWEST;
+    if (placement.nice > 0)    return THREAD_PRIORITY_BELOW_NORMAL;
+    return THREAD_PRIORITY_NORMAL;
+}
+#endif
+
+/**
+ * Apply CPU Affinity, Scheduling and Name to the Calling Thread
+ * @param placement CPUs, scheduling policy/priority and nice value to apply
+ * @param name Thread name shown in debuggers and profilers (truncated to 15 characters on Linux)
+ * @return true if every requested setting was applied
+ *
+ * Real-time policies and negative nice values usually need elevated
+ * privileges (CAP_SYS_NICE on Linux); when refused, the thread keeps running
+ * with the default scheduling rather than failing the server.
+ */
+bool ApplyThreadPlacement(const ThreadPlacement& placement, const std::string& name)
+{
+    bool ok = true;
+
+#ifdef _WIN32
+    // Name (Windows 10 1607+, looked up at runtime for older systems)
+    HMODULE kernel = GetModuleHandleW(L"kernel32.dll");
+    SetThreadDescriptionFn setDescription = kernel ? (SetThreadDescriptionFn)GetProcAddress(kernel, "SetThreadDescription") : nullptr;
+    if (setDescription)
+    {
+        std::wstring wideName(name.begin(), name.end());
+        setDescription(GetCurrentThread(), wideName.c_str());
+    }
+
+    if (!placement.cpus.empty())
+    {
+        DWORD_PTR mask = 0;
+        for (int cpu : placement.cpus)
+        {
+            if (cpu >= 0 && cpu < (int)(sizeof(DWORD_PTR) * 8)) mask |= ((DWORD_PTR)1 << cpu);
+        }
+        if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask))
+        {
+            if (DEBUG) std::cerr << name << ": failed to set CPU affinity" << std::endl;
+            ok = false;
+        }
+    }
+
+    if (placement.policy != ThreadPolicy::Default || placement.setNice)
+    {
+        if (!SetThreadPriority(GetCurrentThread(), windowsPriority(placement)))
+        {
+            if (DEBUG) std::cerr << name << ": failed to set thread priority" << std::endl;
+            ok = false;
+        }
+    }
+#else
+    // Name
+    #if defined(__APPLE__)
+    pthread_setname_np(name.substr(0, 63).c_str());
+    #else
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+    #endif
+
+    // CPU affinity (not available on macOS)
+    if (!placement.cpus.empty())
+    {
+    #ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : placement.cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+        {
+            if (DEBUG) std::cerr << name << ": failed to set CPU affinity. Error: " << rc << std::endl;
+            ok = false;
+        }
+    #else
+        if (DEBUG) std::cerr << name << ": CPU affinity is not supported on this platform" << std::endl;
+        ok = false;
+    #endif
+    }
+
+    // Real-time scheduling
+    if (placement.policy != ThreadPolicy::Default)
+    {
+        int policy = placement.policy == ThreadPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+        sched_param param;
+        param.sched_priority = placement.priority;
+        if (param.sched_priority < sched_get_priority_min(policy)) param.sched_priority = sched_get_priority_min(policy);
+        if (param.sched_priority > sched_get_priority_max(policy)) param.sched_priority = sched_get_priority_max(policy);
+
+        int rc = pthread_setschedparam(pthread_self(), policy, &param);
+        if (rc != 0)
+        {
+            if (DEBUG) std::cerr << name << ": failed to set real-time scheduling. Error: " << rc << std::endl;
+            ok = false;
+        }
+    }
+    else if (placement.setNice)
+    {
+    #ifdef __linux__
+        // Linux applies nice values per thread id
+        if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), placement.nice) != 0)
+        {
+            if (DEBUG) std::cerr << name << ": failed to set nice value. Error: " << errno << std::endl;
+            ok = false;
+        }
+    #else
+        // Elsewhere setpriority() would renice the whole process
+        if (DEBUG) std::cerr << name << ": per-thread nice is not supported on this platform" << std::endl;
+        ok = false;
+    #endif
+    }
+#endif
+
+    return ok;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Scheduling class requested for a TourBox thread
+enum class ThreadPolicy
+{
+	Default,		// leave the OS default (SCHED_OTHER)
+	Fifo,			// SCHED_FIFO real-time
+	RoundRobin		// SCHED_RR real-time
+};
+
+// CPU and scheduling placement for one kind of TourBox thread
+struct ThreadPlacement
+{
+	std::vector<int> cpus;						// CPUs the thread may run on (empty = any)
+	ThreadPolicy policy = ThreadPolicy::Default;
+	int priority = 0;							// real-time priority for Fifo / RoundRobin
+	bool setNice = false;
+	int nice = 0;								// nice value for Default policy threads
+};
+
+// Placement of the accept thread, the per-client I/O threads and the dispatcher
+struct ThreadOptions
+{
+	ThreadPlacement accept;
+	ThreadPlacement io;
+	ThreadPlacement dispatch;
+	std::string namePrefix = "tourbox";			// "<prefix>-accept", "<prefix>-io-N", "<prefix>-dispatch"
+};
+
+// Apply placement and name to the calling thread. Settings that are not
+// supported or not permitted are skipped; returns false if any was skipped.
+bool ApplyThreadPlacement(const ThreadPlacement& placement, const std::string& name);
@@ -0,0 +1,249 @@
+#include "tourbox_timer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+/**
+ * Constructor - Empty Wheel
+ */
+TimerWheel::TimerWheel() : running(false), currentTick(0), nextId(1), epochNs(steadyNowNs())
+{
+    for (auto& level : slots)
+    {
+        for (auto& slot : level) slot = nullptr;
+    }
+}
+
+/**
+ * Destructor - Stop the Thread and Drop Pending Timers
+ */
+TimerWheel::~TimerWheel()
+{
+    Stop();
+    for (auto& pair : timers) delete pair.second;
+}
+
+/**
+ * Start the Timer Thread
+ * @param placement CPU / scheduling placement for the thread
+ * @param threadName Name shown in debuggers and profilers
+ */
+void TimerWheel::Start(const ThreadPlacement& placement, const std::string& threadName)
+{
+    if (running) return;
+
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        epochNs = steadyNowNs();
+        currentTick = 0;
+    }
+    running = true;
+    thread = std::thread([this, placement, threadName]()
+    {
+        ApplyThreadPlacement(placement, threadName);
+        Run();
+    });
+}
+
+/**
+ * Stop the Timer Thread
+ * Pending timers are discarded without running
+ */
+void TimerWheel::Stop()
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        running = false;
+    }
+    wake.notify_one();
+
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+
+    std::lock_guard<std::mutex> g(mutex);
+    for (auto& pair : timers) delete pair.second;
+    timers.clear();
+    for (auto& level : slots)
+    {
+        for (auto& slot : level) slot = nullptr;
+    }
+}
+
+/**
+ * Milliseconds Since Start
+ * @return Tick the wheel should have reached by now
+ */
+uint64_t TimerWheel::tickNow() const
+{
+    return (uint64_t)((steadyNowNs() - epochNs) / 1000000);
+}
+
+/**
+ * Schedule a Timer
+ * @param delayMs Delay in milliseconds
+ * @param callback Runs on the timer thread, without the wheel's lock held
+ * @return Id for Cancel(), or 0 if the wheel is not running
+ */
+TimerWheel::TimerId TimerWheel::Schedule(int64_t delayMs, std::function<void()> callback)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running) return 0;
+
+    Timer* timer = new Timer();
+    timer->id = nextId++;
+    timer->callback = std::move(callback);
+
+    // Relative to real time rather than currentTick, which lags while the thread sleeps;
+    // an empty wheel has nothing to catch up on and jumps to the present
+    uint64_t now = tickNow();
+    if (now < currentTick) now = currentTick;
+    if (timers.empty()) currentTick = now;
+    timer->expiryTick = now + (uint64_t)(delayMs > 0 ? delayMs : 0) + 1;
+
+    TimerId id = timer->id;
+    bool wasEmpty = timers.empty();
+    timers[id] = timer;
+    place(timer);
+    lock.unlock();
+
+    if (wasEmpty) wake.notify_one();
+    return id;
+}
+
+/**
+ * Cancel a Timer
+ * @param id Id returned by Schedule()
+ * @return true if the timer was still pending
+ */
+bool TimerWheel::Cancel(TimerId id)
+{
+    std::lock_guard<std::mutex> g(mutex);
+    auto it = timers.find(id);
+    if (it == timers.end()) return false;
+
+    unlink(it->second);
+    delete it->second;
+    timers.erase(it);
+    return true;
+}
+
+/**
+ * Put a Timer in the Slot for its Expiry
+ * The level is chosen by how far away the expiry is; each level's slot
+ * index comes from that level's bits of the absolute expiry tick
+ */
+void TimerWheel::place(Timer* timer)
+{
+    uint64_t expiry = timer->expiryTick;
+    if (expiry <= currentTick) expiry = currentTick + 1;
+
+    uint64_t delta = expiry - currentTick;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) level++;
+
+    // Beyond the last level: park in its furthest slot and re-place on the way down
+    uint64_t limit = 1ULL << (kSlotBits * kLevels);
+    if (delta >= limit) expiry = currentTick + limit - 1;
+
+    timer->level = level;
+    timer->slot = (int)((expiry >> (kSlotBits * level)) & (kSlots - 1));
+    timer->prev = nullptr;
+    timer->next = slots[level][timer->slot];
+    if (timer->next) timer->next->prev = timer;
+    slots[level][timer->slot] = timer;
+}
+
+/**
+ * Remove a Timer from its Slot
+ */
+void TimerWheel::unlink(Timer* timer)
+{
+    if (timer->prev) timer->prev->next = timer->next;
+    else slots[timer->level][timer->slot] = timer->next;
+    if (timer->next) timer->next->prev = timer->prev;
+    timer->prev = timer->next = nullptr;
+}
+
+/**
+ * Turn the Wheel by One Tick
+ * @param due Receives the callbacks of timers that expired
+ *
+ * When a lower level wraps, the next slot of the level above is emptied and
+ * its timers re-placed, which moves them one level closer to firing
+ */
+void TimerWheel::advance(std::vector<std::function<void()>>& due)
+{
+    currentTick++;
+
+    for (int level = 1; level < kLevels; level++)
+    {
+        if ((currentTick & ((1ULL << (kSlotBits * level)) - 1)) != 0) break;
+
+        int slot = (int)((currentTick >> (kSlotBits * level)) & (kSlots - 1));
+        Timer* timer = slots[level][slot];
+        slots[level][slot] = nullptr;
+        while (timer)
+        {
+            Timer* next = timer->next;
+            place(timer);
+            timer = next;
+        }
+    }
+
+    int slot = (int)(currentTick & (kSlots - 1));
+    Timer* timer = slots[0][slot];
+    while (timer)
+    {
+        Timer* next = timer->next;
+        if (timer->expiryTick <= currentTick)
+        {
+            unlink(timer);
+            due.push_back(std::move(timer->callback));
+            timers.erase(timer->id);
+            delete timer;
+        }
+        timer = next;
+    }
+}
+
+/**
+ * Timer Loop
+ * Sleeps until the next tick while timers are pending, and indefinitely
+ * (until Schedule() wakes it) when the wheel is empty
+ */
+void TimerWheel::Run()
+{
+    std::vector<std::function<void()>> due;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (running)
+    {
+        if (timers.empty())
+        {
+            wake.wait(lock, [this]() { return !running || !timers.empty(); });
+            continue;
+        }
+
+        uint64_t target = tickNow();
+        while (currentTick < target && !timers.empty()) advance(due);
+        if (timers.empty() && currentTick < target) currentTick = target;
+
+        if (!due.empty())
+        {
+            lock.unlock();
+            for (auto& callback : due) callback();
+            due.clear();
+            lock.lock();
+            continue;
+        }
+
+        int64_t nextTickNs = epochNs + (int64_t)(currentTick + 1) * 1000000;
+        wake.wait_for(lock, std::chrono::nanoseconds(std::max<int64_t>(0, nextTickNs - steadyNowNs())));
+    }
+
+    if (DEBUG) std::cout << "Timer thread stopped" << std::endl;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "tourbox_thread.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Monotonic clock in nanoseconds, the time base for the wheel and every deadline scheduled on it
+inline int64_t steadyNowNs()
+{
+	return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Hierarchical timing wheel driven by one thread
+// 4 levels of 64 slots at 1 ms resolution cover ~4.6 hours; longer timers are
+// parked in the last level and re-placed as the wheel turns. Scheduling and
+// cancelling are O(1); callbacks run on the timer thread.
+class TimerWheel
+{
+	public:
+		typedef uint64_t TimerId;
+
+		TimerWheel();
+		~TimerWheel();
+
+		void Start(const ThreadPlacement& placement, const std::string& threadName);
+		void Stop();
+		bool IsRunning() const { return running; }
+
+		// Run callback on the timer thread after delayMs (rounded up to the next tick); returns 0 if stopped
+		TimerId Schedule(int64_t delayMs, std::function<void()> callback);
+
+		// Remove a pending timer; false if it already fired or was cancelled
+		bool Cancel(TimerId id);
+
+	private:
+		static const int kLevels = 4;
+		static const int kSlotBits = 6;
+		static const int kSlots = 1 << kSlotBits;
+
+		struct Timer
+		{
+			TimerId id;
+			uint64_t expiryTick;
+			std::function<void()> callback;
+			Timer* prev;
+			Timer* next;
+			int level;
+			int slot;
+		};
+
+		void Run();
+		void place(Timer* timer);
+		void unlink(Timer* timer);
+		void advance(std::vector<std::function<void()>>& due);
+		uint64_t tickNow() const;
+
+		std::atomic<bool> running;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable wake;
+
+		Timer* slots[kLevels][kSlots];
+		std::unordered_map<TimerId, Timer*> timers;
+		uint64_t currentTick;
+		TimerId nextId;
+		int64_t epochNs;
+};
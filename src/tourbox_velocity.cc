@@ -0,0 +1,86 @@
+#include "tourbox_velocity.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Evaluate the Curve
+ * @param velocity Smoothed velocity in steps per second
+ * @return Multiplier applied to the raw step count
+ */
+double AccelerationCurve::Multiplier(double velocity) const
+{
+    double m = gain;
+    switch (type)
+    {
+        case Linear:
+            m = gain + slope * velocity;
+            break;
+
+        case Power:
+            m = gain * std::pow(std::max(1.0, velocity / (threshold > 0 ? threshold : 1.0)), exponent);
+            break;
+
+        case Table:
+            // Piecewise linear between points, clamped to the first / last multiplier
+            if (table.empty()) break;
+            if (velocity <= table.front().first) { m = table.front().second; break; }
+            if (velocity >= table.back().first) { m = table.back().second; break; }
+            for (size_t i = 1; i < table.size(); i++)
+            {
+                if (velocity <= table[i].first)
+                {
+                    const auto& a = table[i - 1];
+                    const auto& b = table[i];
+                    double t = (b.first > a.first) ? (velocity - a.first) / (b.first - a.first) : 1.0;
+                    m = a.second + t * (b.second - a.second);
+                    break;
+                }
+            }
+            break;
+    }
+
+    if (maxMultiplier > 0 && m > maxMultiplier) m = maxMultiplier;
+    return m < 0 ? 0 : m;
+}
+
+/**
+ * Constructor - Start at rest
+ */
+VelocityEstimator::VelocityEstimator() : lastTimeNs(0), lastDirection(0), velocity(0)
+{
+}
+
+/**
+ * Update the Velocity Estimate
+ * @param timeNs Arrival time of the steps (any monotonic-enough clock, in ns)
+ * @param direction +1 / -1
+ * @param count Number of steps that arrived together
+ * @param options Smoothing and reset settings
+ * @return Smoothed velocity in steps per second
+ *
+ * Uses the gap since the previous group; steps arriving in one packet count
+ * as arriving together. A direction change or a gap longer than resetMs
+ * starts again from rest, so a slow first nudge is never accelerated. Groups
+ * sharing a timestamp keep the current estimate.
+ */
+double VelocityEstimator::Update(int64_t timeNs, int direction, int count, const AccelerationOptions& options)
+{
+    int64_t gapNs = timeNs - lastTimeNs;
+    bool fromRest = lastTimeNs == 0 || direction != lastDirection ||
+                    gapNs > (int64_t)options.resetMs * 1000000;
+
+    if (fromRest)
+    {
+        velocity = 0;
+    }
+    else if (gapNs > 0)
+    {
+        double sample = count / (gapNs / 1e9);
+        double alpha = std::min(1.0, std::max(0.01, options.smoothing));
+        velocity = alpha * sample + (1 - alpha) * velocity;
+    }
+
+    lastTimeNs = timeNs;
+    lastDirection = direction;
+    return velocity;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "tourbox_events.h"
+
+// Maps rotation velocity (steps per second) to a delta multiplier
+struct AccelerationCurve
+{
+	enum Type { Linear, Power, Table };
+
+	Type type = Linear;
+	double gain = 1.0;			// base multiplier
+	double slope = 0.05;		// Linear: extra multiplier per step/s
+	double threshold = 10.0;	// Power: velocity where acceleration starts
+	double exponent = 1.0;		// Power: growth above threshold
+	std::vector<std::pair<double, double>> table;	// Table: (velocity, multiplier) points, sorted by velocity
+	double maxMultiplier = 0;	// cap (0 = none)
+
+	double Multiplier(double velocity) const;
+};
+
+// Per-axis acceleration settings (set before StartServer)
+struct AccelerationOptions
+{
+	bool enabled = false;
+	double smoothing = 0.5;		// EWMA weight of the newest velocity sample (0..1]
+	int resetMs = 200;			// gap after which the control is considered to start from rest
+	AccelerationCurve curves[kMaxRotationAxes];
+};
+
+// Estimates the speed of one rotation control from the arrival times of its steps
+class VelocityEstimator
+{
+	public:
+		VelocityEstimator();
+
+		// Feed count steps in direction arriving at timeNs; returns the smoothed velocity in steps/s
+		double Update(int64_t timeNs, int direction, int count, const AccelerationOptions& options);
+
+	private:
+		int64_t lastTimeNs;
+		int lastDirection;
+		double velocity;
+};
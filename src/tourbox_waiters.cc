@@ -0,0 +1,113 @@
+#include "tourbox_waiters.h"
+#include <iostream>
+
+const bool DEBUG = false; // Disable debug output for Node.js addon
+
+/**
+ * Constructor - Empty Registry
+ * @param timers Wheel that runs the timeouts
+ */
+WaiterRegistry::WaiterRegistry(TimerWheel& t) : timers(t), owner(0), pending(0)
+{
+}
+
+/**
+ * Register a Waiter
+ * @param waiterId Caller's id, echoed in the result
+ * @param eventId Interned name of the event that resolves it
+ * @param timeoutMs Milliseconds before it times out (<= 0 = never)
+ * @return false if a timeout was requested but the timer wheel is not running
+ *
+ * The timer is scheduled under the registry lock, so even a timeout that
+ * fires at once finds the waiter (its callback waits for the lock).
+ */
+bool WaiterRegistry::Add(uint64_t waiterId, uint16_t eventId, int64_t timeoutMs)
+{
+    Waiter waiter;
+    waiter.id = waiterId;
+    waiter.eventId = eventId;
+    waiter.timer = 0;
+
+    std::lock_guard<std::mutex> g(mutex);
+    if (timeoutMs > 0)
+    {
+        waiter.timer = timers.Schedule(timeoutMs, [this, waiterId]() { expire(waiterId); });
+        if (!waiter.timer) return false;
+    }
+    waiters.push_back(waiter);
+    pending.store((int)waiters.size(), std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * Resolve Waiters for an Event
+ * @param ev Decoded event; every waiter on its id is matched
+ */
+void WaiterRegistry::match(const TourBoxEvent& ev)
+{
+    auto* results = new std::vector<WaiterResult>();
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        auto it = waiters.begin();
+        while (it != waiters.end())
+        {
+            if (it->eventId != ev.id)
+            {
+                ++it;
+                continue;
+            }
+
+            if (it->timer) timers.Cancel(it->timer);
+            WaiterResult result;
+            result.waiterId = it->id;
+            result.outcome = WaiterResult::Matched;
+            result.event = ev;
+            result.event.raw = nullptr;
+            results->push_back(result);
+            it = waiters.erase(it);
+        }
+        pending.store((int)waiters.size(), std::memory_order_relaxed);
+    }
+
+    if (results->empty())
+    {
+        delete results;
+        return;
+    }
+
+    if (DEBUG) std::cout << "Resolved " << results->size() << " waiter(s) on " << EventName(ev.id) << std::endl;
+    DeliverWaiterResults(owner, results);
+}
+
+/**
+ * Time Out a Waiter (timer thread)
+ * @param waiterId Waiter whose timeout fired; a no-op if it was matched meanwhile
+ */
+void WaiterRegistry::expire(uint64_t waiterId)
+{
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        auto it = waiters.begin();
+        while (it != waiters.end() && it->id != waiterId) ++it;
+        if (it == waiters.end()) return;
+        waiters.erase(it);
+        pending.store((int)waiters.size(), std::memory_order_relaxed);
+    }
+
+    WaiterResult result = {};
+    result.waiterId = waiterId;
+    result.outcome = WaiterResult::TimedOut;
+    DeliverWaiterResults(owner, new std::vector<WaiterResult>(1, result));
+}
+
+/**
+ * Forget Every Waiter
+ * Called once the producers and the timer thread have stopped; the caller
+ * settles the promises itself
+ */
+void WaiterRegistry::Clear()
+{
+    std::lock_guard<std::mutex> g(mutex);
+    waiters.clear();
+    pending.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "tourbox_events.h"
+#include "tourbox_timer.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Outcome of one waitFor(): the matching event or a timeout
+struct WaiterResult
+{
+	uint64_t waiterId;
+	enum Outcome { Matched, TimedOut } outcome;
+	TourBoxEvent event;			// valid when Matched (raw is always null)
+};
+
+// Hand finished waiters of server owner to Node.js, taking ownership (defined in tourbox_addon.cc)
+extern void DeliverWaiterResults(int owner, std::vector<WaiterResult>* results);
+
+// Pending "resolve on the next <event>" requests. Producers offer every event they decode;
+// with nothing pending that costs one relaxed load. Timeouts run on the shared timer wheel.
+class WaiterRegistry
+{
+	public:
+		explicit WaiterRegistry(TimerWheel& timers);
+
+		// Wait for the next event with this id (timeoutMs <= 0 = no timeout); false if the timer is not running
+		bool Add(uint64_t waiterId, uint16_t eventId, int64_t timeoutMs);
+
+		// Producers (any thread): resolve the waiters for ev.id
+		void Offer(const TourBoxEvent& ev)
+		{
+			if (pending.load(std::memory_order_relaxed) == 0) return;
+			match(ev);
+		}
+
+		// Drop every pending waiter without a result (server stopped)
+		void Clear();
+
+		// Server id passed to DeliverWaiterResults; set before Start
+		void SetOwner(int id) { owner = id; }
+
+	private:
+		struct Waiter
+		{
+			uint64_t id;
+			uint16_t eventId;
+			TimerWheel::TimerId timer;
+		};
+
+		void match(const TourBoxEvent& ev);
+		void expire(uint64_t waiterId);
+
+		TimerWheel& timers;
+		int owner;
+		std::atomic<int> pending;
+		std::mutex mutex;
+		std::vector<Waiter> waiters;
+};